@@ -0,0 +1,194 @@
+// measures the aliasing of the antialiased outputs for each quality and oversampling setting. each
+// module is rendered at pitches swept from 55 Hz up to Nyquist, and the spectrum of each output is
+// split into the harmonics of the fundamental and everything else, which is aliasing (or noise). the
+// ratio of the two is reported in dB along with the time per sample of the setting, so the cheapest
+// setting that meets a given spec can be picked.
+#include <chrono>
+#include <complex>
+#include "../src/dsp/PalmLoopEngine.cpp"
+#include "../src/PalmLoop.cpp"
+#include "../src/dsp/TachyonEntanglerEngine.cpp"
+#include "../src/TachyonEntangler.cpp"
+#include "../src/dsp/D_InfEngine.cpp"
+#include "../src/D_Inf.cpp"
+
+
+Plugin *pluginInstance;
+
+
+static const float SAMPLE_RATE = 48000.0f;
+static const int FFT_SIZE = 16384;
+// frames rendered before the analyzed ones, so the outputs have settled.
+static const int WARMUP = 2048;
+// bins on each side of a harmonic counted as part of it. the Blackman-Harris main lobe is 4 bins wide
+// on each side.
+static const int LOBE = 4;
+// the top of the band aliasing is measured in with --audible.
+static const float AUDIBLE_LIMIT = 20000.0f;
+
+
+// in-place radix-2 FFT. size has to be a power of 2.
+static void fft(std::vector<std::complex<double>> &x) {
+    int n = x.size();
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(x[i], x[j]);
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        std::complex<double> w = std::polar(1.0, -2.0 * M_PI / len);
+        for (int i = 0; i < n; i += len) {
+            std::complex<double> wk = 1.0;
+            for (int k = 0; k < len / 2; ++k) {
+                std::complex<double> u = x[i + k];
+                std::complex<double> v = x[i + k + len / 2] * wk;
+                x[i + k] = u + v;
+                x[i + k + len / 2] = u - v;
+                wk *= w;
+            }
+        }
+    }
+}
+
+
+// returns the power outside the harmonics of fundamental relative to the power of the harmonics, in dB.
+// DC isn't counted as either. the outputs pitched an octave lower have their harmonics on the same grid
+// at half the fundamental, so that's what's passed in for every output.
+static float aliasToSignal(const std::vector<float> &samples, float fundamental, float limit) {
+    std::vector<std::complex<double>> x(FFT_SIZE);
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        // 4-term Blackman-Harris, whose sidelobes are ~92 dB down.
+        double t = 2.0 * M_PI * i / FFT_SIZE;
+        double window = 0.35875 - 0.48829 * cos(t) + 0.14128 * cos(2.0 * t) - 0.01168 * cos(3.0 * t);
+        x[i] = samples[i] * window;
+    }
+    fft(x);
+
+    float binWidth = SAMPLE_RATE / FFT_SIZE;
+    int lastBin = std::min(FFT_SIZE / 2, (int) (limit / binWidth));
+    std::vector<bool> harmonic(FFT_SIZE / 2 + 1, false);
+    for (float f = fundamental; f < SAMPLE_RATE / 2.0f; f += fundamental) {
+        int center = (int) std::round(f / binWidth);
+        for (int b = std::max(0, center - LOBE); b <= std::min(FFT_SIZE / 2, center + LOBE); ++b) {
+            harmonic[b] = true;
+        }
+    }
+    double signal = 1e-30;
+    double alias = 1e-30;
+    for (int b = LOBE + 1; b <= FFT_SIZE / 2; ++b) {
+        double power = std::norm(x[b]);
+        if (harmonic[b]) {
+            signal += power;
+        }
+        else if (b <= lastBin) {
+            alias += power;
+        }
+    }
+    return 10.0f * log10(alias / signal);
+}
+
+
+struct Measured {
+    std::string output;
+    float worst = -INFINITY;
+    float worstFreq = 0.0f;
+    float mean = 0.0f;
+};
+
+
+// sweeps the pitch of a module configured by setup, measuring each of the given outputs. the pitch is set
+// through the V/OCT input, relative to the default C4.
+template <class TModule>
+void measure(const std::string &setting, std::function<void(TModule &)> setup, int vOctInput,
+             std::vector<std::pair<int, const char *>> outputs, float limit) {
+    std::vector<Measured> measured(outputs.size());
+    for (size_t o = 0; o < outputs.size(); ++o) {
+        measured[o].output = outputs[o].second;
+    }
+    double seconds = 0.0;
+    long frames = 0;
+    int pitches = 0;
+    for (float pitch = log2f(55.0f); exp2f(pitch) < SAMPLE_RATE / 2.0f; pitch += 0.25f) {
+        TModule module;
+        setup(module);
+        for (Output &output : module.outputs) {
+            output.channels = 1;
+        }
+        module.inputs[vOctInput].channels = 1;
+        module.inputs[vOctInput].setVoltage(pitch - 8.031360f);
+        Module::ProcessArgs args = {SAMPLE_RATE, 1.0f / SAMPLE_RATE};
+        APP->engine->sampleTime = args.sampleTime;
+        module.onSampleRateChange();
+
+        std::vector<std::vector<float>> samples(outputs.size(), std::vector<float>(FFT_SIZE));
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < WARMUP + FFT_SIZE; ++i) {
+            module.process(args);
+            if (i >= WARMUP) {
+                for (size_t o = 0; o < outputs.size(); ++o) {
+                    samples[o][i - WARMUP] = module.outputs[outputs[o].first].getVoltage();
+                }
+            }
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        frames += WARMUP + FFT_SIZE;
+
+        for (size_t o = 0; o < outputs.size(); ++o) {
+            float ratio = aliasToSignal(samples[o], exp2f(pitch) / 2.0f, limit);
+            if (ratio > measured[o].worst) {
+                measured[o].worst = ratio;
+                measured[o].worstFreq = exp2f(pitch);
+            }
+            measured[o].mean += ratio;
+        }
+        ++pitches;
+    }
+    for (const Measured &m : measured) {
+        printf("%-32s %-6s %8.1f dB at %5.0f Hz %8.1f dB %9.2f ns/sample\n", setting.c_str(), m.output.c_str(),
+               m.worst, m.worstFreq, m.mean / pitches, 1e9 * seconds / frames);
+    }
+}
+
+
+// usage: aliasing [--audible]
+int main(int argc, char **argv) {
+    float limit = (argc > 1 && std::string(argv[1]) == "--audible") ? AUDIBLE_LIMIT : SAMPLE_RATE / 2.0f;
+    cpuLevel() = detectCpuLevel();
+    printf("alias-to-signal ratio up to %g Hz at %g Hz, pitch swept from 55 Hz to Nyquist in quarter octaves\n",
+           limit, SAMPLE_RATE);
+    printf("%-32s %-6s %23s %11s %19s\n", "setting", "output", "worst", "mean", "cost");
+
+    static const char *blepNames[] = {"2-point", "4-point", "8-point"};
+    for (int quality = 0; quality < PalmLoop::NUM_BLEP_QUALITIES; ++quality) {
+        measure<PalmLoop>(string::f("PalmLoop %s polyBLEP", blepNames[quality]), [=](PalmLoop &m) {
+            m.settings.blepQuality = quality;
+            m.publishSettings();
+        }, PalmLoop::V_OCT_INPUT, {
+            {PalmLoop::SAW_OUTPUT, "saw"},
+            {PalmLoop::SQR_OUTPUT, "square"},
+            {PalmLoop::TRI_OUTPUT, "tri"},
+        }, limit);
+    }
+    // B hard synced to A at a ratio that doesn't line up with A's cycle.
+    for (int oversampling = 1; oversampling <= TachyonEntangler::MAX_OVERSAMPLING; oversampling *= 2) {
+        measure<TachyonEntangler>(string::f("TachyonEntangler %dx, B synced", oversampling), [=](TachyonEntangler &m) {
+            m.seed(0);
+            m.settings.oversampling = oversampling;
+            m.publishSettings();
+            m.params[TachyonEntangler::B_RATIO_PARAM].setValue(0.77f);
+            m.params[TachyonEntangler::A_SYNC_PROB_PARAM].setValue(0.0f);
+            m.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(1.0f);
+        }, TachyonEntangler::A_V_OCT_INPUT, {
+            {TachyonEntangler::A_SAW_OUTPUT, "A saw"},
+            {TachyonEntangler::A_SQR_OUTPUT, "A sqr"},
+            {TachyonEntangler::B_SAW_OUTPUT, "B saw"},
+            {TachyonEntangler::B_SQR_OUTPUT, "B sqr"},
+        }, limit);
+    }
+    return 0;
+}
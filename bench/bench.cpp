@@ -0,0 +1,230 @@
+// renders a fixed number of seconds of each module under a few modulation scenarios and reports the
+// time per sample. the module sources are compiled in directly, against the stand-in rack.hpp in
+// this directory, so the numbers cover exactly the code that ships in the plugin.
+#include <chrono>
+#include "../src/dsp/PalmLoopEngine.cpp"
+#include "../src/PalmLoop.cpp"
+#include "../src/dsp/TachyonEntanglerEngine.cpp"
+#include "../src/TachyonEntangler.cpp"
+#include "../src/dsp/D_InfEngine.cpp"
+#include "../src/D_Inf.cpp"
+
+
+Plugin *pluginInstance;
+
+
+static const float SAMPLE_RATE = 48000.0f;
+
+
+// a few cycles of an audio-rate modulator, precomputed so the benchmark doesn't time the sine.
+struct Modulator {
+    static const int LENGTH = 1200;
+    float table[LENGTH];
+
+    Modulator(float freq) {
+        for (int i = 0; i < LENGTH; ++i) {
+            table[i] = 5.0f * std::sin(2.0f * M_PI * freq * i / SAMPLE_RATE);
+        }
+    }
+    float operator[](long i) const {
+        return table[i % LENGTH];
+    }
+};
+
+
+static void connect(Port &port, int channels) {
+    port.channels = channels;
+}
+
+
+// connects all outputs, unless the scenario connected some itself.
+template <class TModule>
+void run(const char *name, TModule &module, float seconds, std::function<void(TModule &, long)> modulate = nullptr) {
+    random::generator().seed(0);
+    bool connected = false;
+    for (Output &output : module.outputs) {
+        connected = connected || output.isConnected();
+    }
+    for (Output &output : module.outputs) {
+        if (!connected) {
+            connect(output, 1);
+        }
+    }
+    Module::ProcessArgs args = {SAMPLE_RATE, 1.0f / SAMPLE_RATE};
+    APP->engine->sampleTime = args.sampleTime;
+    module.onSampleRateChange();
+
+    long frames = (long) (seconds * SAMPLE_RATE);
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < frames; ++i) {
+        if (modulate) {
+            modulate(module, i);
+        }
+        module.process(args);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / frames;
+    printf("%-52s %9.2f ns/sample %14.0f samples/s\n", name, ns, 1e9 / ns);
+#ifdef KHZ_PROFILE
+    printf("%s", module.engine.profile.dump().c_str());
+#endif
+}
+
+
+static void benchPalmLoop(float seconds) {
+    static const Modulator fm(441.0f);
+    for (int channels : {1, 16}) {
+        std::string voices = string::f(" (%d voice%s)", channels, channels > 1 ? "s" : "");
+        {
+            PalmLoop module;
+            connect(module.inputs[PalmLoop::V_OCT_INPUT], channels);
+            run<PalmLoop>(("PalmLoop: static pitch" + voices).c_str(), module, seconds);
+        }
+        {
+            PalmLoop module;
+            connect(module.inputs[PalmLoop::V_OCT_INPUT], channels);
+            connect(module.inputs[PalmLoop::LIN_FM_INPUT], channels);
+            module.params[PalmLoop::LIN_FM_PARAM].setValue(5.0f);
+            run<PalmLoop>(("PalmLoop: audio-rate lin FM" + voices).c_str(), module, seconds, [](PalmLoop &m, long i) {
+                for (int c = 0; c < m.inputs[PalmLoop::LIN_FM_INPUT].channels; ++c) {
+                    m.inputs[PalmLoop::LIN_FM_INPUT].setVoltage(fm[i + 7 * c], c);
+                }
+            });
+        }
+        {
+            PalmLoop module;
+            connect(module.inputs[PalmLoop::V_OCT_INPUT], channels);
+            connect(module.inputs[PalmLoop::EXP_FM_INPUT], channels);
+            module.params[PalmLoop::EXP_FM_PARAM].setValue(0.5f);
+            run<PalmLoop>(("PalmLoop: audio-rate exp FM" + voices).c_str(), module, seconds, [](PalmLoop &m, long i) {
+                for (int c = 0; c < m.inputs[PalmLoop::EXP_FM_INPUT].channels; ++c) {
+                    m.inputs[PalmLoop::EXP_FM_INPUT].setVoltage(fm[i + 7 * c], c);
+                }
+            });
+        }
+        if (channels > 1) {
+            // a 16-voice unison stack, against 16 polyphonic voices above.
+            PalmLoop module;
+            module.settings.unisonVoices = 16;
+            module.settings.unisonWidth = 100;
+            module.publishSettings();
+            connect(module.inputs[PalmLoop::V_OCT_INPUT], 1);
+            run<PalmLoop>("PalmLoop: 16-voice unison, stereo", module, seconds);
+        }
+        static const char *sineModes[] = {"polynomial", "linear table", "cubic table"};
+        for (int mode = 0; mode < PalmLoop::NUM_SINE_MODES; ++mode) {
+            PalmLoop module;
+            module.settings.sineMode = mode;
+            module.publishSettings();
+            connect(module.inputs[PalmLoop::V_OCT_INPUT], channels);
+            connect(module.outputs[PalmLoop::SIN_OUTPUT], 1);
+            connect(module.outputs[PalmLoop::SUB_OUTPUT], 1);
+            run<PalmLoop>(string::f("PalmLoop: sin and sub, %s%s", sineModes[mode], voices.c_str()).c_str(), module, seconds);
+        }
+    }
+}
+
+
+static void benchTachyonEntangler(float seconds) {
+    static const Modulator fm(441.0f);
+    for (int channels : {1, 16}) {
+        std::string voices = string::f(" (%d voice%s)", channels, channels > 1 ? "s" : "");
+        {
+            TachyonEntangler module;
+            connect(module.inputs[TachyonEntangler::A_V_OCT_INPUT], channels);
+            run<TachyonEntangler>(("TachyonEntangler: static pitch" + voices).c_str(), module, seconds);
+        }
+        {
+            TachyonEntangler module;
+            connect(module.inputs[TachyonEntangler::A_V_OCT_INPUT], channels);
+            connect(module.inputs[TachyonEntangler::A_LIN_FM_INPUT], channels);
+            module.params[TachyonEntangler::A_LIN_FM_PARAM].setValue(5.0f);
+            run<TachyonEntangler>(("TachyonEntangler: audio-rate lin FM" + voices).c_str(), module, seconds, [](TachyonEntangler &m, long i) {
+                for (int c = 0; c < m.inputs[TachyonEntangler::A_LIN_FM_INPUT].channels; ++c) {
+                    m.inputs[TachyonEntangler::A_LIN_FM_INPUT].setVoltage(fm[i + 7 * c], c);
+                }
+            });
+        }
+        {
+            TachyonEntangler module;
+            connect(module.inputs[TachyonEntangler::A_V_OCT_INPUT], channels);
+            module.params[TachyonEntangler::A_CHAOS_PARAM].setValue(1.0f);
+            module.params[TachyonEntangler::B_CHAOS_PARAM].setValue(1.0f);
+            run<TachyonEntangler>(("TachyonEntangler: full chaos" + voices).c_str(), module, seconds);
+        }
+        {
+            TachyonEntangler module;
+            connect(module.inputs[TachyonEntangler::A_V_OCT_INPUT], channels);
+            module.params[TachyonEntangler::B_RATIO_PARAM].setValue(1.3f);
+            module.params[TachyonEntangler::A_SYNC_PROB_PARAM].setValue(1.0f);
+            module.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(1.0f);
+            run<TachyonEntangler>(("TachyonEntangler: 100% sync probability" + voices).c_str(), module, seconds);
+        }
+        for (int n : {4, 8}) {
+            TachyonEntangler module;
+            module.settings.oscillators = n;
+            module.publishSettings();
+            connect(module.inputs[TachyonEntangler::A_V_OCT_INPUT], channels);
+            module.params[TachyonEntangler::B_RATIO_PARAM].setValue(1.3f);
+            module.params[TachyonEntangler::A_SYNC_PROB_PARAM].setValue(1.0f);
+            module.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(1.0f);
+            run<TachyonEntangler>(string::f("TachyonEntangler: 100%% sync, ring of %d%s", n, voices.c_str()).c_str(), module, seconds);
+        }
+    }
+}
+
+
+static void benchD_Inf(float seconds) {
+    {
+        D_Inf module;
+        connect(module.inputs[D_Inf::A_INPUT], 1);
+        run<D_Inf>("D_Inf: static", module, seconds);
+    }
+    {
+        D_Inf module;
+        connect(module.inputs[D_Inf::A_INPUT], 1);
+        connect(module.inputs[D_Inf::INVERT_INPUT], 1);
+        connect(module.inputs[D_Inf::TRANSPOSE_INPUT], 1);
+        module.params[D_Inf::INVERT_PARAM].setValue(1.0f);
+        run<D_Inf>("D_Inf: 100 Hz triggers", module, seconds, [](D_Inf &m, long i) {
+            float gate = (i % 480 < 240) ? 10.0f : 0.0f;
+            m.inputs[D_Inf::INVERT_INPUT].setVoltage(gate);
+            m.inputs[D_Inf::TRANSPOSE_INPUT].setVoltage(gate);
+        });
+    }
+    {
+        D_Inf module;
+        connect(module.inputs[D_Inf::A_INPUT], 16);
+        connect(module.inputs[D_Inf::INVERT_INPUT], 16);
+        connect(module.inputs[D_Inf::TRANSPOSE_INPUT], 1);
+        module.params[D_Inf::INVERT_PARAM].setValue(1.0f);
+        run<D_Inf>("D_Inf: 100 Hz triggers (16 channels)", module, seconds, [](D_Inf &m, long i) {
+            for (int c = 0; c < 16; ++c) {
+                m.inputs[D_Inf::INVERT_INPUT].setVoltage((i % (480 + c) < 240) ? 10.0f : 0.0f, c);
+            }
+            m.inputs[D_Inf::TRANSPOSE_INPUT].setVoltage((i % 480 < 240) ? 10.0f : 0.0f);
+        });
+    }
+}
+
+
+// usage: bench [seconds per configuration] [sse4|avx2|avx512]
+// like the plugin, it uses the best kernels the CPU supports, unless a lower level is given.
+int main(int argc, char **argv) {
+    float seconds = (argc > 1) ? atof(argv[1]) : 10.0f;
+    cpuLevel() = detectCpuLevel();
+    if (argc > 2) {
+        static const char *levels[] = {"sse4", "avx2", "avx512"};
+        for (int level = CPU_SSE4; level < NUM_CPU_LEVELS; ++level) {
+            if (std::string(argv[2]) == levels[level]) {
+                cpuLevel() = std::min(level, detectCpuLevel());
+            }
+        }
+    }
+    printf("rendering %g s of audio at %g Hz per configuration, with the %s kernels\n", seconds, SAMPLE_RATE, cpuLevelName(cpuLevel()));
+    benchPalmLoop(seconds);
+    benchTachyonEntangler(seconds);
+    benchD_Inf(seconds);
+    return 0;
+}
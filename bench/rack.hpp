@@ -0,0 +1,350 @@
+// a stand-in for the parts of the Rack SDK that the modules use, so they can be built and run without
+// Rack. the simd types and functions are the engines' stand-in, from dsp/simd.hpp. the engine side
+// only holds params and port voltages, and the widget side is empty, so that the module sources
+// compile unchanged.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <immintrin.h>
+#include "dsp/simd.hpp"
+
+
+typedef struct json_t json_t;
+inline json_t *json_object() { return NULL; }
+inline json_t *json_integer(long long) { return NULL; }
+inline json_t *json_real(double) { return NULL; }
+inline json_t *json_boolean(bool) { return NULL; }
+inline int json_object_set_new(json_t *, const char *, json_t *) { return 0; }
+inline json_t *json_object_get(const json_t *, const char *) { return NULL; }
+inline long long json_integer_value(const json_t *) { return 0; }
+inline double json_real_value(const json_t *) { return 0.0; }
+inline bool json_is_true(const json_t *) { return false; }
+
+
+namespace rack {
+
+namespace math {
+
+inline int clamp(int x, int a, int b) { return std::min(std::max(x, a), b); }
+inline float clamp(float x, float a = 0.0f, float b = 1.0f) { return std::fmin(std::fmax(x, a), b); }
+
+struct Vec {
+    float x = 0.0f;
+    float y = 0.0f;
+    Vec() {}
+    Vec(float x, float y) : x(x), y(y) {}
+};
+
+struct Rect {
+    Vec pos;
+    Vec size;
+};
+
+} // namespace math
+
+using namespace math;
+
+
+namespace random {
+
+// the benchmark seeds this, so runs are repeatable.
+inline std::mt19937 &generator() {
+    static std::mt19937 rng(0);
+    return rng;
+}
+
+inline uint32_t u32() {
+    return generator()();
+}
+
+inline float uniform() {
+    return std::uniform_real_distribution<float>(0.0f, 1.0f)(generator());
+}
+
+} // namespace random
+
+
+namespace string {
+
+inline std::string f(const char *format, ...) {
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    return buffer;
+}
+
+} // namespace string
+
+
+namespace dsp {
+
+template <typename T = float>
+struct TSchmittTrigger {
+    T state = T::mask();
+
+    T process(T in) {
+        T on = (in >= 1.0f);
+        T off = (in <= 0.0f);
+        T triggered = ~state & on;
+        state = simd::ifelse(on, T::mask(), state);
+        state = simd::ifelse(off, T::zero(), state);
+        return triggered;
+    }
+};
+
+template <>
+struct TSchmittTrigger<float> {
+    bool state = true;
+
+    bool process(float in) {
+        if (state) {
+            if (in <= 0.0f) {
+                state = false;
+            }
+        }
+        else if (in >= 1.0f) {
+            state = true;
+            return true;
+        }
+        return false;
+    }
+};
+
+typedef TSchmittTrigger<float> SchmittTrigger;
+
+struct ClockDivider {
+    uint32_t clock = 0;
+    uint32_t division = 1;
+
+    void setDivision(uint32_t d) { division = d; }
+    uint32_t getDivision() { return division; }
+    bool process() {
+        if (++clock >= division) {
+            clock = 0;
+            return true;
+        }
+        return false;
+    }
+};
+
+} // namespace dsp
+
+
+namespace plugin {
+struct Model;
+}
+
+
+namespace engine {
+
+struct Param {
+    float value = 0.0f;
+    float getValue() { return value; }
+    void setValue(float v) { value = v; }
+};
+
+struct Port {
+    float voltages[16] = {};
+    int channels = 0;
+
+    float getVoltage(int c = 0) { return voltages[c]; }
+    void setVoltage(float v, int c = 0) { voltages[c] = v; }
+    int getChannels() { return channels; }
+    // like in Rack, a disconnected port stays at 0 channels.
+    void setChannels(int c) {
+        if (channels > 0) {
+            channels = c;
+        }
+    }
+    bool isConnected() { return channels > 0; }
+    template <typename T>
+    T getVoltageSimd(int c) { return T::load(&voltages[c]); }
+    template <typename T>
+    T getPolyVoltageSimd(int c) { return (channels == 1) ? T(voltages[0]) : getVoltageSimd<T>(c); }
+    template <typename T>
+    void setVoltageSimd(T v, int c) { v.store(&voltages[c]); }
+};
+
+struct Input : Port {};
+struct Output : Port {};
+struct Light {};
+
+struct Engine {
+    float sampleTime = 1.0f / 48000.0f;
+    float getSampleTime() { return sampleTime; }
+};
+
+struct Module;
+
+// the neighbour on one side, set by the caller like the engine does when modules are placed side by side.
+struct Expander {
+    Module *module = NULL;
+};
+
+struct Module {
+    plugin::Model *model = NULL;
+    std::vector<Param> params;
+    std::vector<Input> inputs;
+    std::vector<Output> outputs;
+    std::vector<Light> lights;
+    Expander leftExpander;
+    Expander rightExpander;
+    // set while the module is disabled, in which case the engine doesn't process it.
+    bool bypass = false;
+
+    struct ProcessArgs {
+        float sampleRate;
+        float sampleTime;
+    };
+
+    virtual ~Module() {}
+    void config(int numParams, int numInputs, int numOutputs, int numLights) {
+        params.resize(numParams);
+        inputs.resize(numInputs);
+        outputs.resize(numOutputs);
+        lights.resize(numLights);
+    }
+    void configParam(int id, float minValue, float maxValue, float defaultValue) {
+        params[id].value = defaultValue;
+    }
+    virtual void process(const ProcessArgs &args) {}
+    virtual void onSampleRateChange() {}
+    virtual json_t *dataToJson() { return NULL; }
+    virtual void dataFromJson(json_t *rootJ) {}
+};
+
+} // namespace engine
+
+using namespace engine;
+
+
+namespace event {
+struct Action {};
+}
+
+namespace window {
+struct Svg {};
+struct Window {
+    Svg *loadSvg(std::string) { return NULL; }
+};
+}
+
+namespace widget {
+struct Widget {
+    math::Rect box;
+    virtual ~Widget() {}
+    void addChild(Widget *w) { delete w; }
+};
+}
+
+namespace ui {
+struct MenuItem : widget::Widget {
+    std::string text;
+    std::string rightText;
+    virtual void onAction(const event::Action &e) {}
+};
+struct MenuLabel : MenuItem {};
+struct MenuEntry : widget::Widget {};
+struct Menu : widget::Widget {};
+}
+
+#define CHECKMARK(x) ((x) ? "✔" : "")
+#define INFO(format, ...) fprintf(stderr, "[info] " format "\n", ##__VA_ARGS__)
+
+namespace app {
+struct SvgWidget : widget::Widget {
+    void setSvg(window::Svg *) {}
+};
+struct CircularShadow : widget::Widget {};
+struct ParamWidget : widget::Widget {};
+struct RoundKnob : ParamWidget {
+    bool snap = false;
+    CircularShadow shadowWidget;
+    CircularShadow *shadow = &shadowWidget;
+    void setSvg(window::Svg *) {}
+};
+struct SvgSwitch : ParamWidget {
+    void addFrame(window::Svg *) {}
+};
+struct PortWidget : widget::Widget {};
+struct SvgPort : PortWidget {
+    CircularShadow shadowWidget;
+    CircularShadow *shadow = &shadowWidget;
+    void setSvg(window::Svg *) {}
+};
+struct SvgScrew : widget::Widget {
+    SvgWidget widget;
+    SvgWidget *sw = &widget;
+};
+struct ModuleWidget : widget::Widget {
+    engine::Module *module = NULL;
+    void setModule(engine::Module *m) { module = m; }
+    void setPanel(window::Svg *) {}
+    void addParam(ParamWidget *w) { delete w; }
+    void addInput(PortWidget *w) { delete w; }
+    void addOutput(PortWidget *w) { delete w; }
+    virtual void appendContextMenu(ui::Menu *menu) {}
+};
+static const float RACK_GRID_WIDTH = 15.0f;
+static const float RACK_GRID_HEIGHT = 380.0f;
+}
+
+using namespace app;
+using namespace ui;
+
+namespace plugin {
+struct Model {};
+struct Plugin {
+    void addModel(Model *) {}
+};
+}
+
+using namespace plugin;
+
+namespace asset {
+inline std::string plugin(Plugin *, std::string path) { return path; }
+}
+
+struct Context {
+    window::Window windowInstance;
+    engine::Engine engineInstance;
+    window::Window *window = &windowInstance;
+    engine::Engine *engine = &engineInstance;
+};
+
+inline Context *contextGet() {
+    static Context context;
+    return &context;
+}
+
+#define APP rack::contextGet()
+
+template <class TModule, class TModuleWidget>
+plugin::Model *createModel(std::string slug) {
+    static plugin::Model model;
+    return &model;
+}
+
+template <class TWidget>
+TWidget *createWidget(math::Vec pos) { return new TWidget; }
+template <class TParamWidget>
+TParamWidget *createParam(math::Vec pos, engine::Module *module, int paramId) { return new TParamWidget; }
+template <class TPortWidget>
+TPortWidget *createInput(math::Vec pos, engine::Module *module, int inputId) { return new TPortWidget; }
+template <class TPortWidget>
+TPortWidget *createOutput(math::Vec pos, engine::Module *module, int outputId) { return new TPortWidget; }
+template <class TMenuItem = ui::MenuItem>
+TMenuItem *createMenuItem(std::string text, std::string rightText = "") { return new TMenuItem; }
+inline ui::MenuLabel *createMenuLabel(std::string text) { return new ui::MenuLabel; }
+
+} // namespace rack
@@ -4,6 +4,9 @@ Plugin *pluginInstance;
 
 void init(Plugin *p) {
 	pluginInstance = p;
+  // the modules select their DSP kernels for this, see dsp/cpu.hpp.
+  cpuLevel() = detectCpuLevel();
+  INFO("21kHz: using the %s kernels", cpuLevelName(cpuLevel()));
 
   p->addModel(modelPalmLoop);
 	p->addModel(modelD_Inf);
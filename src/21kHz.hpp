@@ -1,4 +1,8 @@
+#pragma once
 #include "rack.hpp"
+#include "dsp/profile.hpp"
+#include "dsp/cpu.hpp"
+#include "dsp/math.hpp"
 
 using namespace rack;
 
@@ -10,6 +14,38 @@ extern Model *modelTachyonEntangler;
 
 ////////////////////////////////
 
+// Engines
+
+// the DSP of each module lives in an engine in dsp/, which reads and writes the module's ports through
+// PolySignals (see dsp/signal.hpp). bindPorts() points them at the port voltages once, and the channel
+// counts are copied to the engine before each frame and back to the ports after it.
+template <class TEngine>
+void bindPorts(Module *module, TEngine &engine) {
+    for (size_t i = 0; i < module->inputs.size(); ++i) {
+        engine.inputs[i].voltages = module->inputs[i].voltages;
+    }
+    for (size_t i = 0; i < module->outputs.size(); ++i) {
+        engine.outputs[i].voltages = module->outputs[i].voltages;
+    }
+}
+
+template <class TEngine>
+void pullChannels(Module *module, TEngine &engine) {
+    for (size_t i = 0; i < module->inputs.size(); ++i) {
+        engine.inputs[i].channels = module->inputs[i].getChannels();
+    }
+    for (size_t i = 0; i < module->outputs.size(); ++i) {
+        engine.outputs[i].channels = module->outputs[i].getChannels();
+    }
+}
+
+template <class TEngine>
+void pushChannels(Module *module, TEngine &engine) {
+    for (size_t i = 0; i < module->outputs.size(); ++i) {
+        module->outputs[i].setChannels(engine.outputs[i].channels);
+    }
+}
+
 // Knobs
 
 struct kHzKnob : RoundKnob {
@@ -70,3 +106,100 @@ struct kHzScrew : SvgScrew {
         sw->setSvg(APP->window->loadSvg(asset::plugin(pluginInstance, "res/Components/kHzScrew.svg")));
     }
 };
+
+// Menus
+
+struct kHzChoiceItem : MenuItem {
+    int *choice;
+    int value;
+    // called after the choice is set, e.g. to publish it to the audio thread.
+    std::function<void()> changed;
+    void onAction(const event::Action &e) override {
+        *choice = value;
+        if (changed) {
+            changed();
+        }
+    }
+};
+
+// lists the pitch accuracy tiers, in the order of Exp2Accuracy in dsp/math.hpp.
+inline void appendPitchAccuracyMenu(Menu *menu, int *accuracy, std::function<void()> changed) {
+    static const char *labels[NUM_EXP2_ACCURACIES] = {"Exact", "High (< 0.002 cents)", "Medium (< 0.2 cents)", "Low (< 5 cents)"};
+    menu->addChild(new MenuEntry);
+    menu->addChild(createMenuLabel("Pitch accuracy"));
+    for (int i = 0; i < NUM_EXP2_ACCURACIES; ++i) {
+        kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(labels[i], CHECKMARK(*accuracy == i));
+        item->choice = accuracy;
+        item->value = i;
+        item->changed = changed;
+        menu->addChild(item);
+    }
+}
+
+// the control intervals, in samples. the knobs and control-rate inputs are read once per interval
+// and ramped to in between.
+static const int controlIntervals[] = {16, 32, 64};
+
+// the control interval closest to interval, for values read from a patch.
+inline int nearestControlInterval(int interval) {
+    int nearest = controlIntervals[0];
+    for (int choice : controlIntervals) {
+        if (std::abs(choice - interval) < std::abs(nearest - interval)) {
+            nearest = choice;
+        }
+    }
+    return nearest;
+}
+
+inline void appendControlRateMenu(Menu *menu, int *interval, std::function<void()> changed) {
+    menu->addChild(new MenuEntry);
+    menu->addChild(createMenuLabel("Control rate"));
+    for (int i = 0; i < 3; ++i) {
+        kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(string::f("Every %d samples", controlIntervals[i]), CHECKMARK(*interval == controlIntervals[i]));
+        item->choice = interval;
+        item->value = controlIntervals[i];
+        item->changed = changed;
+        menu->addChild(item);
+    }
+}
+
+// the oscillators render in blocks of 16 samples, which delays their outputs by as much. that's
+// inaudible on its own, but it's also the shortest loop a feedback patch can have.
+inline void appendLatencyMenu(Menu *menu, int *lowLatency, std::function<void()> changed) {
+    static const char *labels[] = {"16 samples (less CPU)", "None (for feedback patches)"};
+    menu->addChild(new MenuEntry);
+    menu->addChild(createMenuLabel("Latency"));
+    for (int i = 0; i < 2; ++i) {
+        kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(labels[i], CHECKMARK(*lowLatency == i));
+        item->choice = lowLatency;
+        item->value = i;
+        item->changed = changed;
+        menu->addChild(item);
+    }
+}
+
+#ifdef KHZ_PROFILE
+struct kHzActionItem : MenuItem {
+    std::function<void()> action;
+    void onAction(const event::Action &e) override {
+        action();
+    }
+};
+
+// lists the profile counters as they were when the menu was opened, with items to reset them and to
+// write them to the log.
+template <int N>
+void appendProfileMenu(Menu *menu, Profile<N> *profile) {
+    menu->addChild(new MenuEntry);
+    menu->addChild(createMenuLabel("Profile"));
+    for (int i = 0; i < N; ++i) {
+        menu->addChild(createMenuLabel(profile->line(i)));
+    }
+    kHzActionItem *resetItem = createMenuItem<kHzActionItem>("Reset counters");
+    resetItem->action = [=]() { profile->reset(); };
+    menu->addChild(resetItem);
+    kHzActionItem *logItem = createMenuItem<kHzActionItem>("Write counters to log");
+    logItem->action = [=]() { INFO("Profile:\n%s", profile->dump().c_str()); };
+    menu->addChild(logItem);
+}
+#endif
@@ -1,32 +1,17 @@
 #include "21kHz.hpp"
+#include "dsp/D_InfEngine.hpp"
 
-struct D_Inf : Module {
-	enum ParamIds {
-        OCTAVE_PARAM,
-        COARSE_PARAM,
-        HALF_SHARP_PARAM,
-        INVERT_PARAM,
-		NUM_PARAMS
-	};
-	enum InputIds {
-        INVERT_INPUT,
-        TRANSPOSE_INPUT,
-        A_INPUT,
-		NUM_INPUTS
-	};
-	enum OutputIds {
-        A_OUTPUT,
-		NUM_OUTPUTS
-	};
+// connects the engine in dsp/D_InfEngine.cpp to Rack, and chains the engines of D_Infs placed side by
+// side.
+struct D_Inf : Module, D_InfIds {
 	enum LightIds {
 		NUM_LIGHTS
 	};
 
-    bool invert = true;
-    bool transpose = true;
-
-    dsp::SchmittTrigger invertTrigger;
-    dsp::SchmittTrigger transposeTrigger;
+    D_InfEngine engine;
+    // whether the module joins a chain with the D_Inf to its left, see process(). it's off in patches
+    // from before chaining, so modules placed side by side keep working on their own.
+    int chained = 0;
 
 	D_Inf() {
     config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -34,41 +19,83 @@ struct D_Inf : Module {
     configParam(COARSE_PARAM, -7, 7, 0);
     configParam(HALF_SHARP_PARAM, 0, 1, 0);
     configParam(INVERT_PARAM, 0, 1, 0);
+    bindPorts(this, engine);
   }
 	void process(const ProcessArgs &args) override;
+  int render(const PolySignal &source, int sourceChannels);
+  D_Inf *chainedLeft();
+  D_Inf *chainedRight();
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *rootJ) override;
 
 };
 
 
-void newState(bool &state, bool inactive, bool triggered) {
-    if (inactive) {
-        state = true;
+// D_Infs placed side by side and set to chain form a chain, processed in one pass by the left-most
+// one, so a stack of transpositions has no cable between its stages and no sample of latency per
+// stage. the A input of every module after the first, if unpatched, takes the output of the module to
+// its left.
+void D_Inf::process(const ProcessArgs &args) {
+    if (chainedLeft()) {
+        return;
     }
-    else {
-        if (triggered) {
-            state = !state;
-        }
+    // the channel count is passed along rather than read back from the output, since an unpatched
+    // output stays at 0 channels.
+    int channels = render(engine.inputs[A_INPUT], inputs[A_INPUT].getChannels());
+    const PolySignal *previous = &engine.outputs[A_OUTPUT];
+    for (D_Inf *next = chainedRight(); next; next = next->chainedRight()) {
+        Input &input = next->inputs[A_INPUT];
+        channels = input.isConnected() ? next->render(next->engine.inputs[A_INPUT], input.getChannels()) : next->render(*previous, channels);
+        previous = &next->engine.outputs[A_OUTPUT];
     }
 }
 
 
-void D_Inf::process(const ProcessArgs &args) {
-    if (params[INVERT_PARAM].getValue() == 0) {
-        invert = false;
+// the module's neighbours in the chain, or NULL if the module on that side isn't a D_Inf or the two
+// aren't chained. rack doesn't process a disabled module, so the chain breaks on both sides of one,
+// and the module to its right starts a chain of its own.
+D_Inf *D_Inf::chainedLeft() {
+    if (!chained || bypass || !leftExpander.module || leftExpander.module->model != modelD_Inf) {
+        return NULL;
     }
-    else {
-        newState(invert, !inputs[INVERT_INPUT].isConnected(), invertTrigger.process(inputs[INVERT_INPUT].getVoltage()));
+    D_Inf *left = static_cast<D_Inf*>(leftExpander.module);
+    return left->bypass ? NULL : left;
+}
+
+D_Inf *D_Inf::chainedRight() {
+    if (!rightExpander.module || rightExpander.module->model != modelD_Inf) {
+        return NULL;
     }
-    newState(transpose, !inputs[TRANSPOSE_INPUT].isConnected(), transposeTrigger.process(inputs[TRANSPOSE_INPUT].getVoltage()));
+    D_Inf *right = static_cast<D_Inf*>(rightExpander.module);
+    return (right->chainedLeft() == this) ? right : NULL;
+}
+
 
-    float output = inputs[A_INPUT].getVoltage();
-    if (invert) {
-        output *= -1.0f;
+json_t *D_Inf::dataToJson() {
+    json_t *rootJ = json_object();
+    json_object_set_new(rootJ, "chained", json_integer(chained));
+    return rootJ;
+}
+
+
+void D_Inf::dataFromJson(json_t *rootJ) {
+    json_t *chainedJ = json_object_get(rootJ, "chained");
+    if (chainedJ) {
+        chained = json_integer_value(chainedJ) != 0;
     }
-    if (transpose) {
-        output += params[OCTAVE_PARAM].getValue() + 0.083333 * params[COARSE_PARAM].getValue() + 0.041667 * params[HALF_SHARP_PARAM].getValue();
+}
+
+
+// renders one frame of this module from the given channels of source, and returns the number of
+// channels rendered.
+int D_Inf::render(const PolySignal &source, int sourceChannels) {
+    pullChannels(this, engine);
+    if (engine.controlsDue()) {
+        engine.knobs.take(params);
     }
-    outputs[A_OUTPUT].setVoltage(output);
+    int channels = engine.render(source, sourceChannels);
+    pushChannels(this, engine);
+    return channels;
 }
 
 
@@ -91,6 +118,24 @@ struct D_InfWidget : ModuleWidget {
     addInput(createInput<kHzPort>(Vec(17, 276), module, D_Inf::A_INPUT));
     addOutput(createOutput<kHzPort>(Vec(17, 318), module, D_Inf::A_OUTPUT));
 	}
+
+  void appendContextMenu(Menu *menu) override {
+    D_Inf *module = dynamic_cast<D_Inf*>(this->module);
+    if (module) {
+        static const char *chainLabels[] = {"Off", "With the D_Inf to the left"};
+        menu->addChild(new MenuEntry);
+        menu->addChild(createMenuLabel("Chain"));
+        for (int i = 0; i < 2; ++i) {
+            kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(chainLabels[i], CHECKMARK(module->chained == i));
+            item->choice = &module->chained;
+            item->value = i;
+            menu->addChild(item);
+        }
+#ifdef KHZ_PROFILE
+        appendProfileMenu(menu, &module->engine.profile);
+#endif
+    }
+  }
 };
 
 Model *modelD_Inf = createModel<D_Inf, D_InfWidget>("kHzD_Inf");
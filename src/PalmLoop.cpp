@@ -1,50 +1,16 @@
 #include "21kHz.hpp"
-#include "dsp/math.hpp"
-#include <array>
-
-using std::array;
-
-struct PalmLoop : Module {
-	enum ParamIds {
-        OCT_PARAM,
-        COARSE_PARAM,
-        FINE_PARAM,
-        EXP_FM_PARAM,
-        LIN_FM_PARAM,
-		NUM_PARAMS
-	};
-	enum InputIds {
-        RESET_INPUT,
-        V_OCT_INPUT,
-        EXP_FM_INPUT,
-        LIN_FM_INPUT,
-		NUM_INPUTS
-	};
-	enum OutputIds {
-        SAW_OUTPUT,
-        SQR_OUTPUT,
-        TRI_OUTPUT,
-        SIN_OUTPUT,
-        SUB_OUTPUT,
-		NUM_OUTPUTS
-	};
+#include "dsp/PalmLoopEngine.hpp"
+
+// connects the engine in dsp/PalmLoopEngine.cpp to Rack. the module keeps the settings and their
+// storage in the patch, and the engine does all of the DSP.
+struct PalmLoop : Module, PalmLoopIds {
 	enum LightIds {
 		NUM_LIGHTS
 	};
 
-    float phase = 0.0f;
-    float oldPhase = 0.0f;
-    float square = 1.0f;
-    int discont = 0;
-    int oldDiscont = 0;
-
-    array<float, 4> sawBuffer;
-    array<float, 4> sqrBuffer;
-    array<float, 4> triBuffer;
-
-    float log2sampleFreq = 15.4284f;
-
-    dsp::SchmittTrigger resetTrigger;
+    PalmLoopEngine engine;
+    // the context menu settings, edited on the UI thread and handed to the engine with publishSettings().
+    PalmLoopEngine::Settings settings;
 
 	PalmLoop() {
     config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -53,141 +19,86 @@ struct PalmLoop : Module {
     configParam(FINE_PARAM, -0.083333, 0.083333, 0.0);
     configParam(EXP_FM_PARAM, -1.0, 1.0, 0.0);
     configParam(LIN_FM_PARAM, -11.7, 11.7, 0.0);
+    bindPorts(this, engine);
+    publishSettings();
   }
 	void process(const ProcessArgs &args) override;
   void onSampleRateChange() override;
+  void publishSettings();
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *rootJ) override;
 
 };
 
 
 void PalmLoop::onSampleRateChange() {
-    log2sampleFreq = log2f(1.0f / APP->engine->getSampleTime()) - 0.00009f;
+    engine.setSampleTime(APP->engine->getSampleTime());
 }
 
 
-// quick explanation: the whole thing is driven by a naive sawtooth, which writes to a four-sample buffer for each
-// (non-sine) waveform. the waves are calculated such that their discontinuities (or in the case of triangle, derivative
-// discontinuities) only occur each time the phasor exceeds a [0, 1) range. when we calculate the outputs, we look to see
-// if a discontinuity occured in the previous sample. if one did, we calculate the polyblep or polyblamp and add it to
-// each sample in the buffer. the output is the oldest buffer sample, which gets overwritten in the following step.
+void PalmLoop::publishSettings() {
+    engine.publishSettings(settings);
+}
 
-void PalmLoop::process(const ProcessArgs &args) {
-    if (resetTrigger.process(inputs[RESET_INPUT].getVoltage())) {
-        phase = 0.0f;
-    }
 
-    for (int i = 0; i <= 2; ++i) {
-        sawBuffer[i] = sawBuffer[i + 1];
-        sqrBuffer[i] = sqrBuffer[i + 1];
-        triBuffer[i] = triBuffer[i + 1];
-    }
+json_t *PalmLoop::dataToJson() {
+    json_t *rootJ = json_object();
+    json_object_set_new(rootJ, "pitchAccuracy", json_integer(settings.pitchAccuracy));
+    json_object_set_new(rootJ, "controlInterval", json_integer(settings.controlInterval));
+    json_object_set_new(rootJ, "blepQuality", json_integer(settings.blepQuality));
+    json_object_set_new(rootJ, "sineMode", json_integer(settings.sineMode));
+    json_object_set_new(rootJ, "unisonVoices", json_integer(settings.unisonVoices));
+    json_object_set_new(rootJ, "unisonSpread", json_integer(settings.unisonSpread));
+    json_object_set_new(rootJ, "unisonWidth", json_integer(settings.unisonWidth));
+    json_object_set_new(rootJ, "lowLatency", json_integer(settings.lowLatency));
+    return rootJ;
+}
 
-    float freq = params[OCT_PARAM].getValue() + 0.031360 + 0.083333 * params[COARSE_PARAM].getValue() + params[FINE_PARAM].getValue() + inputs[V_OCT_INPUT].getVoltage();
-    freq += params[EXP_FM_PARAM].getValue() * inputs[EXP_FM_INPUT].getVoltage();
-    if (freq >= log2sampleFreq) {
-        freq = log2sampleFreq;
-    }
-    freq = powf(2.0f, freq);
-    float incr = 0.0f;
-    if (inputs[LIN_FM_INPUT].isConnected()) {
-        freq += params[LIN_FM_PARAM].getValue() * params[LIN_FM_PARAM].getValue() * params[LIN_FM_PARAM].getValue() * inputs[LIN_FM_INPUT].getVoltage();
-        incr = args.sampleTime * freq;
-        if (incr > 1.0f) {
-            incr = 1.0f;
-        }
-        else if (incr < -1.0f) {
-            incr = -1.0f;
-        }
-    }
-    else {
-        incr = args.sampleTime * freq;
-    }
 
-    phase += incr;
-    if (phase >= 0.0f && phase < 1.0f) {
-        discont = 0;
+void PalmLoop::dataFromJson(json_t *rootJ) {
+    json_t *pitchAccuracyJ = json_object_get(rootJ, "pitchAccuracy");
+    if (pitchAccuracyJ) {
+        settings.pitchAccuracy = clamp((int) json_integer_value(pitchAccuracyJ), 0, NUM_EXP2_ACCURACIES - 1);
     }
-    else if (phase >= 1.0f) {
-        discont = 1;
-        --phase;
-        square *= -1.0f;
+    json_t *controlIntervalJ = json_object_get(rootJ, "controlInterval");
+    if (controlIntervalJ) {
+        settings.controlInterval = nearestControlInterval(json_integer_value(controlIntervalJ));
     }
-    else {
-        discont = -1;
-        ++phase;
-        square *= -1.0f;
+    json_t *blepQualityJ = json_object_get(rootJ, "blepQuality");
+    if (blepQualityJ) {
+        settings.blepQuality = clamp((int) json_integer_value(blepQualityJ), 0, NUM_BLEP_QUALITIES - 1);
     }
-
-    sawBuffer[3] = phase;
-    sqrBuffer[3] = square;
-    if (square >= 0.0f) {
-        triBuffer[3] = phase;
+    json_t *sineModeJ = json_object_get(rootJ, "sineMode");
+    if (sineModeJ) {
+        settings.sineMode = clamp((int) json_integer_value(sineModeJ), 0, NUM_SINE_MODES - 1);
     }
-    else {
-        triBuffer[3] = 1.0f - phase;
+    json_t *unisonVoicesJ = json_object_get(rootJ, "unisonVoices");
+    if (unisonVoicesJ) {
+        settings.unisonVoices = clamp((int) json_integer_value(unisonVoicesJ), 1, 16);
     }
-
-    if (outputs[SAW_OUTPUT].isConnected()) {
-        if (oldDiscont == 1) {
-            polyblep4(sawBuffer, 1.0f - oldPhase / incr, 1.0f);
-        }
-        else if (oldDiscont == -1) {
-            polyblep4(sawBuffer, 1.0f - (oldPhase - 1.0f) / incr, -1.0f);
-        }
-        outputs[SAW_OUTPUT].setVoltage(clamp(10.0f * (sawBuffer[0] - 0.5f), -5.0f, 5.0f));
+    json_t *unisonSpreadJ = json_object_get(rootJ, "unisonSpread");
+    if (unisonSpreadJ) {
+        settings.unisonSpread = clamp((int) json_integer_value(unisonSpreadJ), 0, 100);
     }
-    if (outputs[SQR_OUTPUT].isConnected()) {
-        if (discont == 0) {
-            if (oldDiscont == 1) {
-                polyblep4(sqrBuffer, 1.0f - oldPhase / incr, -2.0f * square);
-            }
-            else if (oldDiscont == -1) {
-                polyblep4(sqrBuffer, 1.0f - (oldPhase - 1.0f) / incr, -2.0f * square);
-            }
-        }
-        else {
-            if (oldDiscont == 1) {
-                polyblep4(sqrBuffer, 1.0f - oldPhase / incr, 2.0f * square);
-            }
-            else if (oldDiscont == -1) {
-                polyblep4(sqrBuffer, 1.0f - (oldPhase - 1.0f) / incr, 2.0f * square);
-            }
-        }
-        outputs[SQR_OUTPUT].setVoltage(clamp(4.9999f * sqrBuffer[0], -5.0f, 5.0f));
-    }
-    if (outputs[TRI_OUTPUT].isConnected()) {
-        if (discont == 0) {
-            if (oldDiscont == 1) {
-                polyblamp4(triBuffer, 1.0f - oldPhase / incr, 2.0f * square * incr);
-            }
-            else if (oldDiscont == -1) {
-                polyblamp4(triBuffer, 1.0f - (oldPhase - 1.0f) / incr, 2.0f * square * incr);
-            }
-        }
-        else {
-            if (oldDiscont == 1) {
-                polyblamp4(triBuffer, 1.0f - oldPhase / incr, -2.0f * square * incr);
-            }
-            else if (oldDiscont == -1) {
-                polyblamp4(triBuffer, 1.0f - (oldPhase - 1.0f) / incr, -2.0f * square * incr);
-            }
-        }
-        outputs[TRI_OUTPUT].setVoltage(clamp(10.0f * (triBuffer[0] - 0.5f), -5.0f, 5.0f));
+    json_t *unisonWidthJ = json_object_get(rootJ, "unisonWidth");
+    if (unisonWidthJ) {
+        settings.unisonWidth = clamp((int) json_integer_value(unisonWidthJ), 0, 100);
     }
-    if (outputs[SIN_OUTPUT].isConnected()) {
-        outputs[SIN_OUTPUT].setVoltage(5.0f * sin_01(phase));
-    }
-    if (outputs[SUB_OUTPUT].isConnected()) {
-        if (square >= 0.0f) {
-            outputs[SUB_OUTPUT].setVoltage(5.0f * sin_01(0.5f * phase));
-        }
-        else {
-            outputs[SUB_OUTPUT].setVoltage(5.0f * sin_01(0.5f * (1.0f - phase)));
-        }
+    json_t *lowLatencyJ = json_object_get(rootJ, "lowLatency");
+    if (lowLatencyJ) {
+        settings.lowLatency = json_integer_value(lowLatencyJ) ? 1 : 0;
     }
+    publishSettings();
+}
+
 
-    oldPhase = phase;
-    oldDiscont = discont;
+void PalmLoop::process(const ProcessArgs &args) {
+    pullChannels(this, engine);
+    if (engine.controlsDue()) {
+        engine.knobs.take(params);
+    }
+    engine.process(args.sampleTime);
+    pushChannels(this, engine);
 }
 
 
@@ -222,6 +133,72 @@ struct PalmLoopWidget : ModuleWidget {
     addOutput(createOutput<kHzPort>(Vec(84, 318), module, PalmLoop::SUB_OUTPUT));
 
 	}
+
+  void appendContextMenu(Menu *menu) override {
+    PalmLoop *module = dynamic_cast<PalmLoop*>(this->module);
+    if (module) {
+        auto publish = [=]() { module->publishSettings(); };
+        appendPitchAccuracyMenu(menu, &module->settings.pitchAccuracy, publish);
+        appendControlRateMenu(menu, &module->settings.controlInterval, publish);
+        appendLatencyMenu(menu, &module->settings.lowLatency, publish);
+
+        static const char *labels[] = {"Low (2-point, 1 sample latency)", "Standard (4-point, 2 samples latency)", "High (8-point, 4 samples latency)"};
+        menu->addChild(new MenuEntry);
+        menu->addChild(createMenuLabel("Antialiasing"));
+        for (int i = 0; i < PalmLoop::NUM_BLEP_QUALITIES; ++i) {
+            kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(labels[i], CHECKMARK(module->settings.blepQuality == i));
+            item->choice = &module->settings.blepQuality;
+            item->value = i;
+            item->changed = publish;
+            menu->addChild(item);
+        }
+
+        static const char *sineLabels[] = {"Polynomial", "Table, linear interpolation", "Table, cubic interpolation"};
+        menu->addChild(new MenuEntry);
+        menu->addChild(createMenuLabel("Sine and sub"));
+        for (int i = 0; i < PalmLoop::NUM_SINE_MODES; ++i) {
+            kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(sineLabels[i], CHECKMARK(module->settings.sineMode == i));
+            item->choice = &module->settings.sineMode;
+            item->value = i;
+            item->changed = publish;
+            menu->addChild(item);
+        }
+
+        static const int unisonVoices[] = {1, 3, 5, 7, 9, 12, 16};
+        menu->addChild(new MenuEntry);
+        menu->addChild(createMenuLabel("Unison"));
+        for (int voices : unisonVoices) {
+            std::string label = (voices == 1) ? "Off" : string::f("%d voices", voices);
+            kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(label, CHECKMARK(module->settings.unisonVoices == voices));
+            item->choice = &module->settings.unisonVoices;
+            item->value = voices;
+            item->changed = publish;
+            menu->addChild(item);
+        }
+        static const int unisonSpreads[] = {5, 10, 20, 35, 50};
+        menu->addChild(createMenuLabel("Unison detune"));
+        for (int spread : unisonSpreads) {
+            kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(string::f("+/- %d cents", spread), CHECKMARK(module->settings.unisonSpread == spread));
+            item->choice = &module->settings.unisonSpread;
+            item->value = spread;
+            item->changed = publish;
+            menu->addChild(item);
+        }
+        static const int unisonWidths[] = {0, 50, 100};
+        static const char *unisonWidthLabels[] = {"Mono", "Half stereo", "Full stereo"};
+        menu->addChild(createMenuLabel("Unison width"));
+        for (int i = 0; i < 3; ++i) {
+            kHzChoiceItem *item = createMenuItem<kHzChoiceItem>(unisonWidthLabels[i], CHECKMARK(module->settings.unisonWidth == unisonWidths[i]));
+            item->choice = &module->settings.unisonWidth;
+            item->value = unisonWidths[i];
+            item->changed = publish;
+            menu->addChild(item);
+        }
+#ifdef KHZ_PROFILE
+        appendProfileMenu(menu, &module->engine.profile);
+#endif
+    }
+  }
 };
 
 Model *modelPalmLoop = createModel<PalmLoop, PalmLoopWidget>("kHzPalmLoop");
@@ -0,0 +1,70 @@
+#include "D_InfEngine.hpp"
+#include <algorithm>
+
+using namespace rack;
+
+
+D_InfEngine::D_InfEngine() {
+    for (int g = 0; g < 4; ++g) {
+        invert[g] = float_4::mask();
+        transpose[g] = float_4::mask();
+    }
+}
+
+
+// state and triggered are masks. the lanes that triggered toggle, unless the trigger input is
+// unpatched, in which case the state is always on.
+static float_4 newState(float_4 state, bool inactive, float_4 triggered) {
+    if (inactive) {
+        return float_4::mask();
+    }
+    return state ^ triggered;
+}
+
+
+void D_InfEngine::updateControls() {
+    KHZ_PROFILE_SCOPE(PROFILE_CONTROLS);
+    offset = knobs[OCTAVE_PARAM] + 0.083333 * knobs[COARSE_PARAM] + 0.041667 * knobs[HALF_SHARP_PARAM];
+    invertEnabled = knobs[INVERT_PARAM] != 0;
+    invertConnected = inputs[INVERT_INPUT].isConnected();
+    transposeConnected = inputs[TRANSPOSE_INPUT].isConnected();
+}
+
+
+// renders one frame from the given channels of source, with the engine's own knobs and triggers, and
+// returns the number of channels rendered.
+int D_InfEngine::render(const PolySignal &source, int sourceChannels) {
+    KHZ_PROFILE_SCOPE(PROFILE_PROCESS);
+    if (controlCounter == 0) {
+        updateControls();
+        controlCounter = CONTROL_INTERVAL;
+    }
+    --controlCounter;
+
+    // like the oscillators, the number of channels follows the input with the most, and a monophonic
+    // cable is shared by all of them.
+    int channels = std::max(1, sourceChannels);
+    channels = std::max(channels, inputs[INVERT_INPUT].getChannels());
+    channels = std::max(channels, inputs[TRANSPOSE_INPUT].getChannels());
+    for (int c = 0; c < channels; c += 4) {
+        int g = c / 4;
+        if (!invertEnabled) {
+            invert[g] = float_4::zero();
+        }
+        else {
+            float_4 triggered = invertTrigger[g].process(inputs[INVERT_INPUT].getPolyVoltageSimd<float_4>(c));
+            KHZ_PROFILE_COUNT(EVENT_INVERT_TOGGLES, invertConnected * profileLanes(triggered));
+            invert[g] = newState(invert[g], !invertConnected, triggered);
+        }
+        float_4 triggered = transposeTrigger[g].process(inputs[TRANSPOSE_INPUT].getPolyVoltageSimd<float_4>(c));
+        KHZ_PROFILE_COUNT(EVENT_TRANSPOSE_TOGGLES, transposeConnected * profileLanes(triggered));
+        transpose[g] = newState(transpose[g], !transposeConnected, triggered);
+
+        float_4 output = source.getPolyVoltageSimd<float_4>(c);
+        output = simd::ifelse(invert[g], -output, output);
+        output = simd::ifelse(transpose[g], output + offset, output);
+        outputs[A_OUTPUT].setVoltageSimd(output, c);
+    }
+    outputs[A_OUTPUT].setChannels(channels);
+    return channels;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "math.hpp"
+#include "events.hpp"
+#include "snapshot.hpp"
+#include "signal.hpp"
+#include "profile.hpp"
+
+
+// the ids of D_Inf's knobs and ports, shared by the engine and the module.
+struct D_InfIds {
+    enum ParamIds {
+        OCTAVE_PARAM,
+        COARSE_PARAM,
+        HALF_SHARP_PARAM,
+        INVERT_PARAM,
+        NUM_PARAMS
+    };
+    enum InputIds {
+        INVERT_INPUT,
+        TRANSPOSE_INPUT,
+        A_INPUT,
+        NUM_INPUTS
+    };
+    enum OutputIds {
+        A_OUTPUT,
+        NUM_OUTPUTS
+    };
+};
+
+
+// D_Inf's DSP, without Rack. the host points inputs and outputs at its voltages (see dsp/signal.hpp),
+// takes the knobs into knobs whenever controlsDue(), and calls render() once per frame. the source is
+// passed to render() rather than always read from the A input, so the module can chain engines.
+struct D_InfEngine : D_InfIds {
+    // profile counters, see dsp/profile.hpp.
+    enum ProfileIds {
+        PROFILE_PROCESS,
+        PROFILE_CONTROLS,
+        EVENT_INVERT_TOGGLES,
+        EVENT_TRANSPOSE_TOGGLES,
+        NUM_PROFILE_IDS
+    };
+
+    static const int CONTROL_INTERVAL = 16;
+
+    PolySignal inputs[NUM_INPUTS];
+    PolySignal outputs[NUM_OUTPUTS];
+    ParamSnapshot<NUM_PARAMS> knobs;
+
+    // the toggle states, as float_4 masks four channels to a float_4, so index [g] holds channels 4g to
+    // 4g + 3. each channel toggles on its own, from its channel of the trigger inputs.
+    float_4 invert[4];
+    float_4 transpose[4];
+
+    // control-rate values, read every CONTROL_INTERVAL samples. unlike the oscillators, D_Inf doesn't
+    // render ahead in blocks, since a pitch CV that lags its gate by a block would be audible.
+    float offset = 0.0f;
+    bool invertEnabled = false;
+    bool invertConnected = false;
+    bool transposeConnected = false;
+    int controlCounter = 0;
+
+    TriggerDetector invertTrigger[4];
+    TriggerDetector transposeTrigger[4];
+
+#ifdef KHZ_PROFILE
+    Profile<NUM_PROFILE_IDS> profile = {"process", "control updates", "invert toggles", "transpose toggles"};
+#endif
+
+    D_InfEngine();
+    // whether the next render() reads knobs.
+    bool controlsDue() const {
+        return controlCounter == 0;
+    }
+    int render(const PolySignal &source, int sourceChannels);
+    void updateControls();
+};
@@ -0,0 +1,507 @@
+#include "PalmLoopEngine.hpp"
+#include <algorithm>
+
+using namespace rack;
+
+
+PalmLoopEngine::PalmLoopEngine() {
+    for (int g = 0; g < 4; ++g) {
+        square[g] = 1.0f;
+    }
+    SineTable::shared();
+    // the unison tables are calculated when a block takes new settings, so the defaults go through the
+    // same way.
+    publishSettings(Settings());
+}
+
+
+void PalmLoopEngine::setSampleTime(float sampleTime) {
+    log2sampleFreq = log2f(1.0f / sampleTime) - 0.00009f;
+}
+
+
+void PalmLoopEngine::publishSettings(const Settings &settings) {
+    settingsBuffer.write(settings);
+}
+
+
+void PalmLoopEngine::updateControls() {
+    KHZ_PROFILE_SCOPE(PROFILE_CONTROLS);
+    int steps = controlDivider.getDivision();
+    pitch.setTarget(knobs[OCT_PARAM] + 0.031360 + 0.083333 * knobs[COARSE_PARAM] + knobs[FINE_PARAM], steps);
+    expFm.setTarget(knobs[EXP_FM_PARAM], steps);
+    linFm.setTarget(knobs[LIN_FM_PARAM] * knobs[LIN_FM_PARAM] * knobs[LIN_FM_PARAM], steps);
+    linFmConnected = inputs[LIN_FM_INPUT].isConnected();
+    connectedOutputs = 0;
+    for (int i = 0; i < NUM_OUTPUTS; ++i) {
+        connectedOutputs |= outputs[i].isConnected() << i;
+    }
+}
+
+
+void PalmLoopEngine::stepControls() {
+    pitch.process();
+    expFm.process();
+    linFm.process();
+}
+
+
+// turns the recorded pitch and fm inputs of voice group g into phase increments. the exponential is by
+// far the most expensive part, and the pitch is usually constant across a block, in which case it's only
+// calculated once.
+void PalmLoopEngine::computeIncrements(float_4 *incr, int g, int frames, float sampleTime) {
+    KHZ_PROFILE_SCOPE(PROFILE_INCREMENTS);
+    float_4 freq[BLOCK_SIZE];
+    bool constantPitch = true;
+    for (int i = 0; i < frames; ++i) {
+        freq[i] = pitch.value + vOctBlock[g][i] + expFm.value * expFmBlock[g][i];
+        KHZ_PROFILE_COUNT(EVENT_PITCH_CLAMPS, profileLanes(freq[i] > log2sampleFreq));
+        freq[i] = simd::fmin(freq[i], log2sampleFreq);
+        constantPitch = constantPitch && !simd::movemask(freq[i] != freq[0]);
+    }
+    if (constantPitch) {
+        float_4 f = exp2Approx(freq[0], activeSettings.pitchAccuracy);
+        for (int i = 0; i < frames; ++i) {
+            freq[i] = f;
+        }
+    }
+    else {
+        for (int i = 0; i < frames; ++i) {
+            freq[i] = exp2Approx(freq[i], activeSettings.pitchAccuracy);
+        }
+    }
+    if (linFmConnected) {
+        for (int i = 0; i < frames; ++i) {
+            incr[i] = simd::clamp(sampleTime * (freq[i] + linFm.value * linFmBlock[g][i]), -1.0f, 1.0f);
+        }
+    }
+    else {
+        for (int i = 0; i < frames; ++i) {
+            incr[i] = sampleTime * freq[i];
+        }
+    }
+}
+
+
+// quick explanation: the whole thing is driven by a naive sawtooth, which writes to an N-sample circular buffer for each
+// (non-sine) waveform. the waves are calculated such that their discontinuities (or in the case of triangle, derivative
+// discontinuities) only occur each time the phasor exceeds a [0, 1) range. the current sample goes in the middle of the
+// buffer, at N / 2, so the N / 2 samples before it haven't been output yet and the N / 2 - 1 slots after it collect the
+// residuals of the samples to come. if a discontinuity occurs, we calculate the polyblep or polyblamp and add it to each
+// slot in the buffer. the output is the oldest slot, which is then cleared to become the furthest future slot, so the
+// latency is N / 2 samples.
+
+template <int N, int OUTPUTS>
+void PalmLoopEngine::renderBlock(int g, const float_4 *incr, int frames) {
+    // OUTPUTS is a bitmask of the output ids to render. it's a template argument, so the tests below are
+    // resolved at compile time and each kernel only contains the work for its outputs.
+    const bool saw = OUTPUTS & (1 << SAW_OUTPUT);
+    const bool sqr = OUTPUTS & (1 << SQR_OUTPUT);
+    const bool tri = OUTPUTS & (1 << TRI_OUTPUT);
+    const bool sin = OUTPUTS & (1 << SIN_OUTPUT);
+    const bool sub = OUTPUTS & (1 << SUB_OUTPUT);
+    ResidualBuffer<float_4, 3, N> &residuals = residualsFor<N>(g);
+
+    KHZ_PROFILE_SCOPE(PROFILE_WAVEFORMS);
+    const EventQueue<BLOCK_SIZE>::Event *event = resetEvents[g].begin();
+    for (int i = 0; i < frames; ++i) {
+        residuals.advance();
+
+        // a reset moves the phase back to 0 at its offset into the frame. the phase runs on up to that
+        // point first, so it may wrap on the way. the wrap is antialiased where it happens, like the
+        // wraps below, and the reset's jumps get a polyblep at the reset. the phase is set so that the
+        // step below lands where the reset phase would be at the end of the frame.
+        if (event != resetEvents[g].end() && event->frame == i) {
+            KHZ_PROFILE_COUNT(EVENT_RESETS, profileLanes(event->mask));
+            float_4 pre = phase[g] + event->offset * incr[i];
+            float_4 wraps = simd::floor(pre);
+            float_4 at = pre - wraps;
+            float_4 flipped = event->mask & (wraps != 0.0f);
+            square[g] = simd::ifelse(flipped, -square[g], square[g]);
+            if ((saw || sqr || tri) && simd::movemask(flipped)) {
+                // where the phase crossed 1 going up, or 0 going down.
+                float_4 wrapOffset = simd::ifelse(flipped, clamp01((((wraps > 0.0f) & 1.0f) - phase[g]) / incr[i]), 0.0f);
+                if (saw) {
+                    polyblep(residuals, SAW_OUTPUT, wrapOffset, simd::ifelse(flipped, wraps, 0.0f));
+                }
+                if (sqr) {
+                    polyblep(residuals, SQR_OUTPUT, wrapOffset, simd::ifelse(flipped, -2.0f * square[g], 0.0f));
+                }
+                if (tri) {
+                    polyblamp(residuals, TRI_OUTPUT, wrapOffset, simd::ifelse(flipped, 2.0f * square[g] * incr[i], 0.0f));
+                }
+            }
+            if (saw) {
+                polyblep(residuals, SAW_OUTPUT, event->offset, simd::ifelse(event->mask, at, 0.0f));
+            }
+            if (tri) {
+                float_4 before = simd::ifelse(square[g] >= 0.0f, at, 1.0f - at);
+                float_4 after = simd::ifelse(square[g] >= 0.0f, 0.0f, 1.0f);
+                polyblep(residuals, TRI_OUTPUT, event->offset, simd::ifelse(event->mask, before - after, 0.0f));
+            }
+            phase[g] = simd::ifelse(event->mask, -event->offset * incr[i], phase[g]);
+            ++event;
+        }
+
+        // discont is 1 where the phase wrapped upwards, -1 where it wrapped downwards, and 0 elsewhere.
+        phase[g] += incr[i];
+        discont[g] = simd::ifelse(phase[g] >= 1.0f, 1.0f, simd::ifelse(phase[g] < 0.0f, -1.0f, 0.0f));
+        phase[g] -= discont[g];
+        square[g] = simd::ifelse(discont[g] != 0.0f, -square[g], square[g]);
+
+        if (saw) {
+            residuals.at(SAW_OUTPUT, N / 2) += phase[g];
+        }
+        if (sqr) {
+            residuals.at(SQR_OUTPUT, N / 2) += square[g];
+        }
+        if (tri) {
+            residuals.at(TRI_OUTPUT, N / 2) += simd::ifelse(square[g] >= 0.0f, phase[g], 1.0f - phase[g]);
+        }
+
+        // lanes without a discontinuity get a zero residual, so the polyblep is only worth calculating
+        // if at least one lane has one.
+        float_4 wrapped = discont[g] != 0.0f;
+        KHZ_PROFILE_COUNT(EVENT_DISCONTS, profileLanes(wrapped));
+        if ((saw || sqr || tri) && simd::movemask(wrapped)) {
+            float_4 offset = 1.0f - (phase[g] - ((discont[g] < 0.0f) & 1.0f)) / incr[i];
+            offset = simd::ifelse(wrapped, offset, 0.0f);
+            if (saw) {
+                polyblep(residuals, SAW_OUTPUT, offset, discont[g]);
+            }
+            if (sqr) {
+                polyblep(residuals, SQR_OUTPUT, offset, simd::ifelse(wrapped, -2.0f * square[g], 0.0f));
+            }
+            if (tri) {
+                polyblamp(residuals, TRI_OUTPUT, offset, simd::ifelse(wrapped, 2.0f * square[g] * incr[i], 0.0f));
+            }
+        }
+
+        if (saw) {
+            outputBlock[SAW_OUTPUT][g][i] = simd::clamp(10.0f * (residuals.at(SAW_OUTPUT, 0) - 0.5f), -5.0f, 5.0f);
+            residuals.at(SAW_OUTPUT, 0) = 0.0f;
+        }
+        if (sqr) {
+            outputBlock[SQR_OUTPUT][g][i] = simd::clamp(4.9999f * residuals.at(SQR_OUTPUT, 0), -5.0f, 5.0f);
+            residuals.at(SQR_OUTPUT, 0) = 0.0f;
+        }
+        if (tri) {
+            outputBlock[TRI_OUTPUT][g][i] = simd::clamp(10.0f * (residuals.at(TRI_OUTPUT, 0) - 0.5f), -5.0f, 5.0f);
+            residuals.at(TRI_OUTPUT, 0) = 0.0f;
+        }
+        // the sines only need the phase here. they're shaped after the loop, in one pass per block.
+        if (sin) {
+            outputBlock[SIN_OUTPUT][g][i] = phase[g];
+        }
+        if (sub) {
+            outputBlock[SUB_OUTPUT][g][i] = 0.5f * simd::ifelse(square[g] >= 0.0f, phase[g], 1.0f - phase[g]);
+        }
+    }
+    if (sin) {
+        shapeSines(outputBlock[SIN_OUTPUT][g], frames);
+    }
+    if (sub) {
+        shapeSines(outputBlock[SUB_OUTPUT][g], frames);
+    }
+}
+
+
+// turns a block of phases into sine outputs in place. the sine mode is switched once per block rather
+// than per sample, or in yet another template argument of the kernels.
+void PalmLoopEngine::shapeSines(float_4 *block, int frames) {
+    const SineTable &table = SineTable::shared();
+    switch (activeSettings.sineMode) {
+        case SINE_TABLE_LINEAR:
+            for (int i = 0; i < frames; ++i) {
+                block[i] = 5.0f * table.linear(block[i]);
+            }
+            break;
+        case SINE_TABLE_CUBIC:
+            for (int i = 0; i < frames; ++i) {
+                block[i] = 5.0f * table.cubic(block[i]);
+            }
+            break;
+        default:
+            for (int i = 0; i < frames; ++i) {
+                block[i] = 5.0f * sin_01(block[i]);
+            }
+            break;
+    }
+}
+
+
+template <>
+ResidualBuffer<float_4, 3, 2> &PalmLoopEngine::residualsFor<2>(int g) {
+    return residuals2[g];
+}
+
+template <>
+ResidualBuffer<float_4, 3, 4> &PalmLoopEngine::residualsFor<4>(int g) {
+    return residuals4[g];
+}
+
+template <>
+ResidualBuffer<float_4, 3, 8> &PalmLoopEngine::residualsFor<8>(int g) {
+    return residuals8[g];
+}
+
+
+// fills table[level][outputs] with the N-point kernel for each CpuLevel and bitmask of outputs from 0
+// to OUTPUTS.
+template <int N, int OUTPUTS>
+struct PalmLoopKernels {
+    static void fill(PalmLoopEngine::Kernel (*table)[1 << PalmLoopEngine::NUM_OUTPUTS]) {
+        table[CPU_SSE4][OUTPUTS] = &PalmLoopEngine::renderBlockSse4<N, OUTPUTS>;
+        table[CPU_AVX2][OUTPUTS] = &PalmLoopEngine::renderBlockAvx2<N, OUTPUTS>;
+        table[CPU_AVX512][OUTPUTS] = &PalmLoopEngine::renderBlockAvx512<N, OUTPUTS>;
+        PalmLoopKernels<N, OUTPUTS - 1>::fill(table);
+    }
+};
+
+template <int N>
+struct PalmLoopKernels<N, -1> {
+    static void fill(PalmLoopEngine::Kernel (*table)[1 << PalmLoopEngine::NUM_OUTPUTS]) {}
+};
+
+
+// switches to the kernel for the given quality and bitmask of connected outputs, at the CPU's level.
+// the residual rows of outputs the old kernel didn't render (all of them after a quality change) hold
+// stale residuals, so they're cleared first. the new kernel doesn't write the output rows of outputs
+// outside the mask, so they're zeroed rather than left holding the last block they played.
+void PalmLoopEngine::selectKernel(int quality, int outputs) {
+    static const int ALL_OUTPUTS = (1 << NUM_OUTPUTS) - 1;
+    static const IncrementKernel incrementKernels[NUM_CPU_LEVELS] = {&PalmLoopEngine::computeIncrementsSse4, &PalmLoopEngine::computeIncrementsAvx2,
+                                                                     &PalmLoopEngine::computeIncrementsAvx512};
+    static const struct Kernels {
+        Kernel table[NUM_BLEP_QUALITIES][NUM_CPU_LEVELS][ALL_OUTPUTS + 1];
+        Kernels() {
+            PalmLoopKernels<2, ALL_OUTPUTS>::fill(table[BLEP_2]);
+            PalmLoopKernels<4, ALL_OUTPUTS>::fill(table[BLEP_4]);
+            PalmLoopKernels<8, ALL_OUTPUTS>::fill(table[BLEP_8]);
+        }
+    } kernels;
+
+    int stale = (quality == kernelQuality) ? outputs & ~kernelOutputs : outputs;
+    for (int b = SAW_OUTPUT; b <= TRI_OUTPUT; ++b) {
+        if (stale & (1 << b)) {
+            for (int g = 0; g < 4; ++g) {
+                residuals2[g].clear(b);
+                residuals4[g].clear(b);
+                residuals8[g].clear(b);
+            }
+        }
+    }
+    for (int b = 0; b < NUM_OUTPUTS; ++b) {
+        if (!(outputs & (1 << b))) {
+            memset(outputBlock[b], 0, sizeof(outputBlock[b]));
+        }
+    }
+    kernel = kernels.table[quality][cpuLevel()][outputs];
+    incrementKernel = incrementKernels[cpuLevel()];
+    kernelQuality = quality;
+    kernelOutputs = outputs;
+}
+
+
+// takes the latest settings from the UI thread, if there are any. the unison tables only depend on the
+// settings, so they're calculated here, rather than at control rate.
+void PalmLoopEngine::takeSettings() {
+    int oldVoices = activeSettings.unisonVoices;
+    if (!settingsBuffer.read(activeSettings)) {
+        return;
+    }
+    blockFrames = activeSettings.lowLatency ? 1 : BLOCK_SIZE;
+    int voices = activeSettings.unisonVoices;
+    float spread = activeSettings.unisonSpread / 1200.0f;
+    float width = activeSettings.unisonWidth / 100.0f;
+    // the gains of each side add up to one, so the mix stays within +/-5 V even when all voices are in
+    // phase, e.g. right after a reset.
+    float gain = 1.0f / voices;
+    for (int v = 0; v < 16; ++v) {
+        // the detunes are evenly spaced from -spread to +spread, and the voices are panned in the same
+        // order, from left to right.
+        float position = (voices > 1) ? 2.0f * v / (voices - 1) - 1.0f : 0.0f;
+        float active = (v < voices) ? gain : 0.0f;
+        unisonRatio[v / 4][v % 4] = exp2f(position * spread);
+        unisonGainLeft[v / 4][v % 4] = active * (1.0f - width * position);
+        unisonGainRight[v / 4][v % 4] = active * (1.0f + width * position);
+    }
+    if (voices > 1 && voices != oldVoices) {
+        // the voices start out at scattered phases, or they'd sound as one until they drift apart.
+        for (int v = 0; v < 16; ++v) {
+            phase[v / 4][v % 4] = fmodf(0.618034f * v, 1.0f);
+        }
+    }
+}
+
+
+// records the inputs into frame pos of the blocks. in unison, every voice follows the first channel of
+// each input.
+void PalmLoopEngine::recordInputs(int pos) {
+    if (activeSettings.unisonVoices > 1) {
+        channels = activeSettings.unisonVoices;
+        for (int c = 0; c < channels; c += 4) {
+            int g = c / 4;
+            vOctBlock[g][pos] = inputs[V_OCT_INPUT].getVoltage();
+            expFmBlock[g][pos] = inputs[EXP_FM_INPUT].getVoltage();
+            linFmBlock[g][pos] = inputs[LIN_FM_INPUT].getVoltage();
+            recordTrigger(resetDetector[g], resetEvents[g], pos, inputs[RESET_INPUT].getVoltage());
+        }
+        return;
+    }
+    channels = std::max(1, inputs[V_OCT_INPUT].getChannels());
+    channels = std::max(channels, inputs[EXP_FM_INPUT].getChannels());
+    channels = std::max(channels, inputs[LIN_FM_INPUT].getChannels());
+    channels = std::max(channels, inputs[RESET_INPUT].getChannels());
+    for (int c = 0; c < channels; c += 4) {
+        int g = c / 4;
+        vOctBlock[g][pos] = inputs[V_OCT_INPUT].getPolyVoltageSimd<float_4>(c);
+        expFmBlock[g][pos] = inputs[EXP_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        linFmBlock[g][pos] = inputs[LIN_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        recordTrigger(resetDetector[g], resetEvents[g], pos, inputs[RESET_INPUT].getPolyVoltageSimd<float_4>(c));
+    }
+}
+
+
+// plays back frame pos of the output blocks.
+void PalmLoopEngine::writeOutputs(int pos) {
+    for (int c = 0; c < outputChannels; c += 4) {
+        for (int i = 0; i < NUM_OUTPUTS; ++i) {
+            outputs[i].setVoltageSimd(outputBlock[i][c / 4][pos], c);
+        }
+    }
+    for (int i = 0; i < NUM_OUTPUTS; ++i) {
+        outputs[i].setChannels(outputChannels);
+    }
+}
+
+
+// renders a block of the unison stack. the pitch is calculated once, for the first voice group, and
+// each voice's increment is that times its detune ratio. the voices go through the same kernels as
+// polyphonic voices, and are then mixed down to one or two channels in the first group's output block.
+void PalmLoopEngine::renderUnison(float sampleTime, int frames) {
+    int groups = (activeSettings.unisonVoices + 3) / 4;
+    float_4 incr[4][BLOCK_SIZE];
+    (this->*incrementKernel)(incr[0], 0, frames, sampleTime);
+    // backwards, so the first group's increments are scaled last.
+    for (int g = groups - 1; g >= 0; --g) {
+        for (int i = 0; i < frames; ++i) {
+            // the detune could push an increment at the lin fm clamp past it.
+            incr[g][i] = simd::clamp(incr[0][i] * unisonRatio[g], -1.0f, 1.0f);
+        }
+        (this->*kernel)(g, incr[g], frames);
+    }
+
+    for (int o = 0; o < NUM_OUTPUTS; ++o) {
+        if (!(kernelOutputs & (1 << o))) {
+            continue;
+        }
+        for (int i = 0; i < frames; ++i) {
+            float_4 left = 0.0f;
+            float_4 right = 0.0f;
+            for (int g = 0; g < groups; ++g) {
+                left += unisonGainLeft[g] * outputBlock[o][g][i];
+                right += unisonGainRight[g] * outputBlock[o][g][i];
+            }
+            outputBlock[o][0][i] = float_4(horizontalSum(left), horizontalSum(right), 0.0f, 0.0f);
+        }
+    }
+    outputChannels = (activeSettings.unisonWidth > 0) ? 2 : 1;
+}
+
+
+// while no output is connected there's nothing to render, so process() only calls this once per block.
+// it keeps updating the controls, to notice when an output gets connected, and keeps the phases running
+// at the current pitch, so the oscillator is roughly where it would have been when it wakes up, at
+// which point the residuals and output blocks from before the sleep are cleared.
+void PalmLoopEngine::sleepBlock(float sampleTime) {
+    KHZ_PROFILE_COUNT(EVENT_SLEEPING_BLOCKS, 1);
+    takeSettings();
+    controlDivider.setDivision(activeSettings.controlInterval / BLOCK_SIZE);
+    if (controlDivider.process()) {
+        updateControls();
+    }
+    stepControls();
+    recordInputs(0);
+    bool unison = activeSettings.unisonVoices > 1;
+    float_4 first;
+    computeIncrements(&first, 0, 1, sampleTime);
+    for (int c = 0; c < channels; c += 4) {
+        int g = c / 4;
+        float_4 incr = first;
+        if (unison) {
+            incr = simd::clamp(first * unisonRatio[g], -1.0f, 1.0f);
+        }
+        else if (g > 0) {
+            computeIncrements(&incr, g, 1, sampleTime);
+        }
+        for (const auto &event : resetEvents[g]) {
+            phase[g] = simd::ifelse(event.mask, 0.0f, phase[g]);
+        }
+        resetEvents[g].clear();
+        skipPhase(phase[g], square[g], BLOCK_SIZE * incr);
+    }
+    if (connectedOutputs) {
+        // selectKernel() only clears the residuals when the outputs change, and the same ones may be
+        // connected again.
+        for (int g = 0; g < 4; ++g) {
+            residuals2[g] = ResidualBuffer<float_4, 3, 2>();
+            residuals4[g] = ResidualBuffer<float_4, 3, 4>();
+            residuals8[g] = ResidualBuffer<float_4, 3, 8>();
+        }
+        memset(outputBlock, 0, sizeof(outputBlock));
+    }
+}
+
+
+void PalmLoopEngine::process(float sampleTime) {
+    if (!connectedOutputs) {
+        if (++blockPos == BLOCK_SIZE) {
+            blockPos = 0;
+            sleepBlock(sampleTime);
+        }
+        return;
+    }
+
+    if (blockFrames > 1) {
+        writeOutputs(blockPos);
+    }
+    recordInputs(blockPos);
+    if (++blockPos < blockFrames) {
+        return;
+    }
+    int frames = blockPos;
+    blockPos = 0;
+    takeSettings();
+    controlDivider.setDivision(activeSettings.controlInterval / blockFrames);
+    if (controlDivider.process()) {
+        updateControls();
+    }
+    stepControls();
+    if (activeSettings.blepQuality != kernelQuality || connectedOutputs != kernelOutputs) {
+        selectKernel(activeSettings.blepQuality, connectedOutputs);
+    }
+    if (activeSettings.unisonVoices > 1) {
+        renderUnison(sampleTime, frames);
+    }
+    else {
+        for (int c = 0; c < channels; c += 4) {
+            int g = c / 4;
+            float_4 incr[BLOCK_SIZE];
+            (this->*incrementKernel)(incr, g, frames, sampleTime);
+            (this->*kernel)(g, incr, frames);
+        }
+        outputChannels = channels;
+    }
+    for (int g = 0; g < 4; ++g) {
+        resetEvents[g].clear();
+    }
+    if (frames == 1) {
+        // low latency, the frame goes out right away.
+        writeOutputs(0);
+    }
+    if (frames != blockFrames) {
+        // the latency changed, and the block that was just rendered is too short or too late to play.
+        memset(outputBlock, 0, sizeof(outputBlock));
+    }
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include "math.hpp"
+#include "events.hpp"
+#include "snapshot.hpp"
+#include "signal.hpp"
+#include "profile.hpp"
+#include "cpu.hpp"
+
+
+// the ids of Palm Loop's knobs and ports and the choices of its settings, shared by the engine and the
+// module, so PalmLoop::SAW_OUTPUT and PalmLoopEngine::SAW_OUTPUT are the same.
+struct PalmLoopIds {
+    enum ParamIds {
+        OCT_PARAM,
+        COARSE_PARAM,
+        FINE_PARAM,
+        EXP_FM_PARAM,
+        LIN_FM_PARAM,
+        NUM_PARAMS
+    };
+    enum InputIds {
+        RESET_INPUT,
+        V_OCT_INPUT,
+        EXP_FM_INPUT,
+        LIN_FM_INPUT,
+        NUM_INPUTS
+    };
+    enum OutputIds {
+        SAW_OUTPUT,
+        SQR_OUTPUT,
+        TRI_OUTPUT,
+        SIN_OUTPUT,
+        SUB_OUTPUT,
+        NUM_OUTPUTS
+    };
+    // residual kernel lengths. longer kernels reject more aliasing, at the cost of CPU and latency.
+    enum BlepQualities {
+        BLEP_2,
+        BLEP_4,
+        BLEP_8,
+        NUM_BLEP_QUALITIES
+    };
+    // how the SIN and SUB outputs turn their phase into a sine, see SineTable in dsp/math.hpp.
+    enum SineModes {
+        SINE_POLYNOMIAL,
+        SINE_TABLE_LINEAR,
+        SINE_TABLE_CUBIC,
+        NUM_SINE_MODES
+    };
+
+    static const int BLOCK_SIZE = 16;
+};
+
+
+// Palm Loop's DSP, without Rack. the host points inputs and outputs at its voltages (see
+// dsp/signal.hpp), takes the knobs into knobs whenever controlsDue(), and calls process() once per
+// frame. the blocks delay the outputs by BLOCK_SIZE frames, unless Settings::lowLatency is set.
+struct PalmLoopEngine : PalmLoopIds {
+    // profile counters, see dsp/profile.hpp. the first ones time sections, the rest count events per
+    // voice.
+    enum ProfileIds {
+        PROFILE_CONTROLS,
+        PROFILE_INCREMENTS,
+        PROFILE_WAVEFORMS,
+        EVENT_DISCONTS,
+        EVENT_PITCH_CLAMPS,
+        EVENT_RESETS,
+        EVENT_SLEEPING_BLOCKS,
+        NUM_PROFILE_IDS
+    };
+
+    PolySignal inputs[NUM_INPUTS];
+    PolySignal outputs[NUM_OUTPUTS];
+    ParamSnapshot<NUM_PARAMS> knobs;
+
+    // voice state is stored four voices to a float_4, so index [g] holds channels 4g to 4g + 3.
+    float_4 phase[4] = {};
+    float_4 square[4];
+    float_4 discont[4] = {};
+
+    // naive saw, square and triangle of each voice group, indexed by their output ids. the buffer
+    // depth is the kernel length, so there's one set of buffers per quality setting.
+    ResidualBuffer<float_4, 3, 2> residuals2[4];
+    ResidualBuffer<float_4, 3, 4> residuals4[4];
+    ResidualBuffer<float_4, 3, 8> residuals8[4];
+
+    // process() records the inputs into these blocks and plays back the outputs of the last rendered
+    // block, so the outputs are delayed by blockFrames samples. in low latency mode the blocks are a
+    // single frame long, which is rendered and played back in the same process().
+    float_4 vOctBlock[4][BLOCK_SIZE] = {};
+    float_4 expFmBlock[4][BLOCK_SIZE] = {};
+    float_4 linFmBlock[4][BLOCK_SIZE] = {};
+    float_4 outputBlock[NUM_OUTPUTS][4][BLOCK_SIZE] = {};
+    int blockPos = 0;
+    int blockFrames = BLOCK_SIZE;
+    int channels = 1;
+    int outputChannels = 1;
+
+    // control-rate values. the knobs are read every controlInterval samples, and the values ramp to
+    // them once per block in between.
+    ControlRamp<float> pitch = 8.03136f;
+    ControlRamp<float> expFm;
+    ControlRamp<float> linFm;
+    bool linFmConnected = false;
+    // a bitmask of output ids. with none connected the engine sleeps, see sleepBlock(). it starts out
+    // with all of them, so the engine is awake until the first control update.
+    int connectedOutputs = (1 << NUM_OUTPUTS) - 1;
+
+    float log2sampleFreq = 15.4284f;
+
+    // the context menu settings. the UI thread hands a copy to the audio thread with publishSettings(),
+    // which process() takes into activeSettings at the start of a block, so a setting never changes in
+    // the middle of rendering one.
+    struct Settings {
+        // one of the Exp2Accuracy tiers.
+        int pitchAccuracy = EXP2_HIGH;
+        int blepQuality = BLEP_4;
+        int sineMode = SINE_POLYNOMIAL;
+        int controlInterval = BLOCK_SIZE;
+        // with more than one unison voice, the engine plays a single detuned stack of that many voices,
+        // spread over unisonSpread cents and panned over unisonWidth percent of the stereo field.
+        int unisonVoices = 1;
+        int unisonSpread = 20;
+        int unisonWidth = 0;
+        // renders every frame on its own instead of in blocks of BLOCK_SIZE, for feedback patches, at
+        // a higher cpu cost.
+        int lowLatency = 0;
+    };
+    Settings activeSettings;
+    TripleBuffer<Settings> settingsBuffer;
+    ControlDivider controlDivider;
+
+    // the resets of the current block, recorded with their offset into the frame so the kernel can
+    // place them between samples.
+    TriggerDetector resetDetector[4];
+    EventQueue<BLOCK_SIZE> resetEvents[4];
+
+    // per unison voice, laid out like the voice state: the frequency ratio of its detune and its gains
+    // into the left and right outputs, which are zero for the unused lanes of the last group. they're
+    // recalculated when the unison settings change, see takeSettings().
+    float_4 unisonRatio[4];
+    float_4 unisonGainLeft[4];
+    float_4 unisonGainRight[4];
+
+    // renders a block of one voice group. there's a kernel for each quality setting and set of
+    // connected outputs, so unpatched outputs cost nothing. selectKernel() swaps it when either changes.
+    // each is compiled for every CpuLevel, and so are the increments, which hold the exponentials.
+    typedef void (PalmLoopEngine::*Kernel)(int g, const float_4 *incr, int frames);
+    typedef void (PalmLoopEngine::*IncrementKernel)(float_4 *incr, int g, int frames, float sampleTime);
+    Kernel kernel = nullptr;
+    IncrementKernel incrementKernel = nullptr;
+    int kernelQuality = -1;
+    int kernelOutputs = 0;
+
+#ifdef KHZ_PROFILE
+    Profile<NUM_PROFILE_IDS> profile = {"control updates", "increments", "waveforms", "discontinuities", "pitch clamps", "resets",
+                                        "sleeping blocks"};
+#endif
+
+    PalmLoopEngine();
+    void setSampleTime(float sampleTime);
+    void publishSettings(const Settings &settings);
+    // whether the next process() reads knobs, i.e. ends a block. the engine always sleeps in blocks of
+    // BLOCK_SIZE.
+    bool controlsDue() const {
+        return blockPos == (connectedOutputs ? blockFrames : BLOCK_SIZE) - 1;
+    }
+    void process(float sampleTime);
+
+    void updateControls();
+    void stepControls();
+    void computeIncrements(float_4 *incr, int g, int frames, float sampleTime);
+    template <int N>
+    ResidualBuffer<float_4, 3, N> &residualsFor(int g);
+    template <int N, int OUTPUTS>
+    void renderBlock(int g, const float_4 *incr, int frames);
+    // the entry points of the kernels at each CpuLevel, see dsp/cpu.hpp.
+    template <int N, int OUTPUTS>
+    KHZ_KERNEL_SSE4 void renderBlockSse4(int g, const float_4 *incr, int frames) {
+        renderBlock<N, OUTPUTS>(g, incr, frames);
+    }
+    template <int N, int OUTPUTS>
+    KHZ_KERNEL_AVX2 void renderBlockAvx2(int g, const float_4 *incr, int frames) {
+        renderBlock<N, OUTPUTS>(g, incr, frames);
+    }
+    template <int N, int OUTPUTS>
+    KHZ_KERNEL_AVX512 void renderBlockAvx512(int g, const float_4 *incr, int frames) {
+        renderBlock<N, OUTPUTS>(g, incr, frames);
+    }
+    KHZ_KERNEL_SSE4 void computeIncrementsSse4(float_4 *incr, int g, int frames, float sampleTime) {
+        computeIncrements(incr, g, frames, sampleTime);
+    }
+    KHZ_KERNEL_AVX2 void computeIncrementsAvx2(float_4 *incr, int g, int frames, float sampleTime) {
+        computeIncrements(incr, g, frames, sampleTime);
+    }
+    KHZ_KERNEL_AVX512 void computeIncrementsAvx512(float_4 *incr, int g, int frames, float sampleTime) {
+        computeIncrements(incr, g, frames, sampleTime);
+    }
+    void shapeSines(float_4 *block, int frames);
+    void selectKernel(int quality, int outputs);
+    void sleepBlock(float sampleTime);
+    void takeSettings();
+    void recordInputs(int pos);
+    void writeOutputs(int pos);
+    void renderUnison(float sampleTime, int frames);
+};
@@ -0,0 +1,576 @@
+#include "TachyonEntanglerEngine.hpp"
+#include <algorithm>
+
+using namespace rack;
+
+
+// the lanes that wrap get a randomized decrement, the others return a decrement of 1. lanes that
+// are out of range without wrapping (e.g. after a sync) keep their previous discont flag.
+static float_4 advancePhase(float_4 &phase, float_4 &square, float_4 incr, float_4 rand, float_4 &discont, Xorshift4 &rng) {
+    phase += incr;
+    float_4 up = (phase >= 1.0f) & (incr >= 0.0f);
+    float_4 down = (phase < 0.0f) & (incr < 0.0f);
+    float_4 wrapped = up | down;
+    discont = simd::ifelse((phase >= 0.0f) & (phase < 1.0f), 0.0f, simd::ifelse(up, 1.0f, simd::ifelse(down, -1.0f, discont)));
+    float_4 decr = 1.0f;
+    if (simd::movemask(wrapped)) {
+        decr = simd::ifelse(wrapped, 1.0f - 2.0f * rand * (rng.uniform() - 0.5f), 1.0f);
+        phase = simd::ifelse(up, simd::fmin(phase - decr, 1.0f), phase);
+        phase = simd::ifelse(down, simd::fmax(phase + decr, -1.0f), phase);
+        square = simd::ifelse(wrapped, -square, square);
+    }
+    return decr;
+}
+
+
+// the value of oscillator k of a ring of n, interpolated from A's value a to B's value b. the ends are
+// passed through as they are, so a ring of two is exactly A and B.
+template <typename T>
+static T ringMix(T a, T b, int k, int n) {
+    if (k == 0) {
+        return a;
+    }
+    if (k == n - 1) {
+        return b;
+    }
+    return a + (b - a) * ((float) k / (n - 1));
+}
+
+
+// sets discont to 0 and flips the square in the lanes where a synced oscillator would have wrapped
+// only after the sync point, i.e. where the sync takes the place of its own discontinuity.
+static void cancelDiscont(float_4 mask, float_4 &discont, float_4 &square) {
+    discont = simd::ifelse(mask, 0.0f, discont);
+    square = simd::ifelse(mask, -square, square);
+}
+
+
+// applies the residuals for the discontinuities an oscillator had in the previous sample. in each
+// lane it either wrapped on its own, was synced by the other oscillator at a time given by the other
+// oscillator's history, or both. decrSelf is the amplitude of a plain wrap, decrSyncUp/decrSyncDown
+// that of a wrap which coincided with a sync, and flipSelf/flipSync select the sign of the square
+// step for the two cases.
+static void applyResiduals(ResidualBuffer<float_4, TachyonEntanglerEngine::NUM_HISTORIES> &history, int saw, int sqr, int phases, int incrs, int otherPhases, int otherIncrs,
+                           float_4 oldDiscont, float_4 otherOldSyncDiscont, float_4 square, float_4 decrSelf, float_4 decrSyncUp, float_4 decrSyncDown,
+                           float_4 flipSelf, float_4 flipSync) {
+    float_4 wrapped = oldDiscont != 0.0f;
+    float_4 synced = otherOldSyncDiscont != 0.0f;
+    if (!simd::movemask(wrapped | synced)) {
+        return;
+    }
+    float_4 wrappedOnly = wrapped & ~synced;
+    float_4 syncedOnly = synced & ~wrapped;
+    float_4 both = wrapped & synced;
+    float_4 oldPhase = history.at(phases, 2);
+    float_4 olderPhase = history.at(phases, 1);
+    float_4 oldIncr = history.at(incrs, 2);
+    float_4 olderIncr = history.at(incrs, 1);
+    float_4 rising = oldIncr >= 0.0f;
+
+    float_4 offsetSelf = 1.0f - (oldPhase - ((oldDiscont != 1.0f) & 1.0f)) / oldIncr;
+    float_4 offsetSync = 1.0f - (history.at(otherPhases, 2) - ((otherOldSyncDiscont != 1.0f) & 1.0f)) / history.at(otherIncrs, 2);
+    float_4 offsetBoth = simd::ifelse(rising, (1.0f - olderPhase) / olderIncr, 1.0f - (oldPhase - 1.0f) / oldIncr);
+
+    float_4 offset = simd::ifelse(wrappedOnly, offsetSelf, simd::ifelse(syncedOnly, offsetSync, simd::ifelse(both, offsetBoth, 0.0f)));
+    float_4 sawStep = simd::ifelse(wrappedOnly, simd::ifelse(oldDiscont == 1.0f, decrSelf, -decrSelf), 0.0f);
+    sawStep = simd::ifelse(syncedOnly, olderPhase + simd::ifelse(rising, oldIncr * offsetSync, -oldIncr * offsetSync - 1.0f), sawStep);
+    sawStep = simd::ifelse(both, simd::ifelse(rising, decrSyncUp, -decrSyncDown), sawStep);
+    float_4 sqrStep = simd::ifelse(wrappedOnly, -2.0f * flipSelf * square, simd::ifelse(both, -2.0f * flipSync * square, 0.0f));
+
+    polyblep(history, saw, offset, sawStep);
+    if (simd::movemask(both)) {
+        polyblep(history, saw, simd::ifelse(both, offsetSync, 0.0f), simd::ifelse(both, oldIncr * (offsetSync - offsetBoth), 0.0f));
+    }
+    polyblep(history, sqr, offset, sqrStep);
+}
+
+
+// applies the residuals of a reset in the previous sample.
+static void applyReset(ResidualBuffer<float_4, TachyonEntanglerEngine::NUM_HISTORIES> &history, int saw, int sqr, const TachyonEntanglerEngine::ResetStep &step) {
+    if (!simd::movemask(step.mask)) {
+        return;
+    }
+    if (simd::movemask(step.wrapSaw != 0.0f)) {
+        polyblep(history, saw, step.wrapOffset, step.wrapSaw);
+        polyblep(history, sqr, step.wrapOffset, step.wrapSqr);
+    }
+    polyblep(history, saw, step.offset, step.saw);
+    polyblep(history, sqr, step.offset, step.sqr);
+}
+
+
+TachyonEntanglerEngine::TachyonEntanglerEngine() {
+    for (int k = 0; k < MAX_OSCILLATORS; ++k) {
+        for (int g = 0; g < 4; ++g) {
+            square[k][g] = 1.0f;
+        }
+    }
+    static const Kernel kernels[NUM_CPU_LEVELS] = {&TachyonEntanglerEngine::renderBlockSse4, &TachyonEntanglerEngine::renderBlockAvx2,
+                                                   &TachyonEntanglerEngine::renderBlockAvx512};
+    kernel = kernels[cpuLevel()];
+}
+
+
+void TachyonEntanglerEngine::setSampleTime(float sampleTime) {
+    log2sampleFreq = log2f(1.0f / sampleTime) - 0.00009f;
+}
+
+
+void TachyonEntanglerEngine::publishSettings(const Settings &settings) {
+    settingsBuffer.write(settings);
+}
+
+
+// takes the latest settings from the UI thread, if there are any, and reseeds the random generators
+// when they come with a new seed, so renders from the same state and inputs are reproducible.
+void TachyonEntanglerEngine::takeSettings() {
+    int oldGeneration = activeSettings.seedGeneration;
+    if (!settingsBuffer.read(activeSettings)) {
+        return;
+    }
+    blockFrames = activeSettings.lowLatency ? 1 : BLOCK_SIZE;
+    if (activeSettings.seedGeneration == oldGeneration) {
+        return;
+    }
+    for (int g = 0; g < 4; ++g) {
+        rng[g].seed(activeSettings.seed + g);
+    }
+}
+
+
+void TachyonEntanglerEngine::updateControls() {
+    KHZ_PROFILE_SCOPE(PROFILE_CONTROLS);
+    int steps = controlDivider.getDivision();
+    centerPitch.setTarget(knobs[A_OCTAVE_PARAM] + 0.031360 + 0.083333 * knobs[A_COARSE_PARAM] + knobs[A_FINE_PARAM], steps);
+    ratioB.setTarget(knobs[B_RATIO_PARAM], steps);
+    expFmA.setTarget(0.2 * knobs[A_EXP_FM_PARAM] * knobs[A_EXP_FM_PARAM] * knobs[A_EXP_FM_PARAM], steps);
+    expFmB.setTarget(0.2 * knobs[B_EXP_FM_PARAM] * knobs[B_EXP_FM_PARAM] * knobs[B_EXP_FM_PARAM], steps);
+    linFmA.setTarget(knobs[A_LIN_FM_PARAM] * knobs[A_LIN_FM_PARAM] * knobs[A_LIN_FM_PARAM], steps);
+    linFmB.setTarget(knobs[B_LIN_FM_PARAM] * knobs[B_LIN_FM_PARAM] * knobs[B_LIN_FM_PARAM], steps);
+    chaosA.setTarget(knobs[A_CHAOS_PARAM], steps);
+    chaosB.setTarget(knobs[B_CHAOS_PARAM], steps);
+    // every voice group gets its targets, not only the active ones, since the channel count can grow
+    // before the next update. the channels past a polyphonic input's count read 0 V, as rack leaves
+    // them.
+    for (int g = 0; g < 4; ++g) {
+        int c = 4 * g;
+        randA[g].setTarget(chaosA.target + knobs[A_CHAOS_MOD_PARAM] * inputs[A_CHAOS_INPUT].getPolyVoltageSimd<float_4>(c), steps);
+        randB[g].setTarget(chaosB.target + knobs[B_CHAOS_MOD_PARAM] * inputs[B_CHAOS_INPUT].getPolyVoltageSimd<float_4>(c), steps);
+        syncProbA[g].setTarget(knobs[A_SYNC_PROB_PARAM] + knobs[A_SYNC_PROB_MOD_PARAM] * inputs[A_SYNC_PROB_INPUT].getPolyVoltageSimd<float_4>(c), steps);
+        syncProbB[g].setTarget(knobs[B_SYNC_PROB_PARAM] + knobs[B_SYNC_PROB_MOD_PARAM] * inputs[B_SYNC_PROB_INPUT].getPolyVoltageSimd<float_4>(c), steps);
+    }
+    expFmConnectedA = inputs[A_EXP_FM_INPUT].isConnected();
+    expFmConnectedB = inputs[B_EXP_FM_INPUT].isConnected();
+    linFmConnectedA = inputs[A_LIN_FM_INPUT].isConnected();
+    linFmConnectedB = inputs[B_LIN_FM_INPUT].isConnected();
+    vOctConnectedB = inputs[B_V_OCT_INPUT].isConnected();
+    outputsA = outputs[A_SAW_OUTPUT].isConnected() || outputs[A_SQR_OUTPUT].isConnected();
+    outputsB = outputs[B_SAW_OUTPUT].isConnected() || outputs[B_SQR_OUTPUT].isConnected();
+}
+
+
+void TachyonEntanglerEngine::stepControls() {
+    centerPitch.process();
+    ratioB.process();
+    expFmA.process();
+    expFmB.process();
+    linFmA.process();
+    linFmB.process();
+    chaosA.process();
+    chaosB.process();
+    // the idle voice groups ramp along with the others, so when they become active they're on the
+    // current ramp rather than finishing one from several updates ago.
+    for (int g = 0; g < 4; ++g) {
+        randA[g].process();
+        randB[g].process();
+        syncProbA[g].process();
+        syncProbB[g].process();
+    }
+}
+
+
+// turns the recorded pitch and fm inputs of voice group g into the phase increments of each oscillator
+// of the ring. the exponentials are by far the most expensive part, and the pitches are usually
+// constant across a block, in which case they're only calculated once.
+void TachyonEntanglerEngine::computeIncrements(float_4 (*incrs)[BLOCK_SIZE], int g, int frames, float sampleTime) {
+    KHZ_PROFILE_SCOPE(PROFILE_INCREMENTS);
+    int n = activeSettings.oscillators;
+    float_4 pitchA[BLOCK_SIZE];
+    float_4 pitchB[BLOCK_SIZE];
+    bool constantPitch = true;
+    for (int i = 0; i < frames; ++i) {
+        pitchA[i] = centerPitch.value + vOctBlockA[g][i];
+        if (expFmConnectedA) {
+            pitchA[i] += expFmA.value * expFmBlockA[g][i];
+        }
+        KHZ_PROFILE_COUNT(EVENT_PITCH_CLAMPS, profileLanes(pitchA[i] > log2sampleFreq));
+        pitchA[i] = simd::fmin(pitchA[i], log2sampleFreq);
+        if (vOctConnectedB) {
+            pitchB[i] = ratioB.value + (centerPitch.value + vOctBlockB[g][i]);
+        }
+        else {
+            pitchB[i] = ratioB.value + pitchA[i];
+        }
+        if (expFmConnectedB) {
+            pitchB[i] += expFmB.value * expFmBlockB[g][i];
+        }
+        KHZ_PROFILE_COUNT(EVENT_PITCH_CLAMPS, profileLanes(pitchB[i] > log2sampleFreq));
+        pitchB[i] = simd::fmin(pitchB[i], log2sampleFreq);
+        constantPitch = constantPitch && !simd::movemask((pitchA[i] != pitchA[0]) | (pitchB[i] != pitchB[0]));
+    }
+    for (int k = 0; k < n; ++k) {
+        float_4 *incr = incrs[k];
+        if (constantPitch) {
+            float_4 freq = exp2Approx(ringMix(pitchA[0], pitchB[0], k, n), activeSettings.pitchAccuracy);
+            for (int i = 0; i < frames; ++i) {
+                incr[i] = freq;
+            }
+        }
+        else {
+            for (int i = 0; i < frames; ++i) {
+                incr[i] = exp2Approx(ringMix(pitchA[i], pitchB[i], k, n), activeSettings.pitchAccuracy);
+            }
+        }
+        bool linFmConnected = (k == 0) ? linFmConnectedA : (k == n - 1) ? linFmConnectedB : linFmConnectedA || linFmConnectedB;
+        if (linFmConnected) {
+            for (int i = 0; i < frames; ++i) {
+                float_4 linA = linFmConnectedA ? linFmA.value * linFmBlockA[g][i] : 0.0f;
+                float_4 linB = linFmConnectedB ? linFmB.value * linFmBlockB[g][i] : 0.0f;
+                incr[i] = simd::clamp(sampleTime * (incr[i] + ringMix(linA, linB, k, n)), -1.0f, 1.0f);
+            }
+        }
+        else {
+            for (int i = 0; i < frames; ++i) {
+                incr[i] = sampleTime * incr[i];
+            }
+        }
+    }
+}
+
+
+// syncs oscillator to to oscillator from, in the lanes where from decided to sync it.
+void TachyonEntanglerEngine::sync(int g, int from, int to, const float_4 *incr) {
+    float_4 synced = syncDiscont[from][g] != 0.0f;
+    if (!simd::movemask(synced)) {
+        return;
+    }
+    KHZ_PROFILE_SCOPE(PROFILE_SYNC);
+    KHZ_PROFILE_COUNT(EVENT_SYNCS, profileLanes(synced));
+    // the discontinuities only matter for the residuals, so they're left alone for an output oscillator
+    // with nothing patched. the oscillators between A and B sync the next one from theirs, so theirs
+    // always count.
+    bool rendered = (to == 0) ? outputsA : (to == activeSettings.oscillators - 1) ? outputsB : true;
+    if (rendered) {
+        float_4 lhs = incr[from] * (phase[to][g] - ((syncDiscont[from][g] != 1.0f) & 1.0f));
+        float_4 rhs = incr[to] * (phase[from][g] - ((discont[to][g] != 1.0f) & 1.0f));
+        float_4 cancel = synced & (lhs <= rhs);
+        if (to == 0) {
+            // oscillator 0 is synced after the rest of the ring has advanced, so only a wrap it had in
+            // this sample can be cancelled.
+            cancel = cancel & (discont[0][g] != 0.0f);
+        }
+        cancelDiscont(cancel, discont[to][g], square[to][g]);
+    }
+    float_4 syncedPhase = simd::ifelse(incr[from] >= 0.0f, phase[from][g], phase[from][g] - 1.0f) / incr[from] * incr[to];
+    syncedPhase += (incr[to] <= 0.0f) & 1.0f;
+    phase[to][g] = simd::ifelse(synced, syncedPhase, phase[to][g]);
+}
+
+
+// renders one step of the ring of voice group g at the (oversampled) engine rate, and writes the
+// outputs to out, indexed by output id. incr, rand and syncProb hold each oscillator's increment,
+// chaos and probability of being synced.
+void TachyonEntanglerEngine::renderSample(int g, const float_4 *incr, const float_4 *rand, const float_4 *syncProb, float_4 *out) {
+    int n = activeSettings.oscillators;
+    int b = n - 1;
+    history[g].advance();
+
+    // each oscillator advances, is synced by the one before it, and then decides whether to sync the
+    // one after it. oscillator 0 is synced last, by B, which closes the ring.
+    float_4 decr[MAX_OSCILLATORS];
+    for (int k = 0; k < n; ++k) {
+        {
+            KHZ_PROFILE_SCOPE(PROFILE_PHASES);
+            decr[k] = advancePhase(phase[k][g], square[k][g], incr[k], rand[k], discont[k][g], rng[g]);
+        }
+        KHZ_PROFILE_COUNT(EVENT_DISCONTS, profileLanes(discont[k][g] != 0.0f));
+        KHZ_PROFILE_COUNT(EVENT_CHAOS_JUMPS, profileLanes(decr[k] != 1.0f));
+        if (k > 0) {
+            sync(g, k - 1, k, incr);
+        }
+        syncDiscont[k][g] = 0.0f;
+        if (simd::movemask(discont[k][g] != 0.0f)) {
+            syncDiscont[k][g] = simd::ifelse(rng[g].uniform() >= 1.0f - syncProb[(k + 1) % n], discont[k][g], 0.0f);
+        }
+    }
+    sync(g, b, 0, incr);
+
+    history[g].at(A_SAW_OUTPUT, 3) = phase[0][g];
+    history[g].at(B_SAW_OUTPUT, 3) = phase[b][g];
+    history[g].at(A_SQR_OUTPUT, 3) = square[0][g];
+    history[g].at(B_SQR_OUTPUT, 3) = square[b][g];
+    for (int k = 0; k < n; ++k) {
+        history[g].at(PHASE_HISTORY + k, 3) = phase[k][g];
+        history[g].at(INCR_HISTORY + k, 3) = incr[k];
+        KHZ_PROFILE_COUNT(EVENT_COINCIDENT_SYNCS, profileLanes((oldDiscont[k][g] != 0.0f) & (oldSyncDiscont[(k + b) % n][g] != 0.0f)));
+    }
+
+    if (outputsA) {
+        KHZ_PROFILE_SCOPE(PROFILE_RESIDUALS);
+        applyResiduals(history[g], A_SAW_OUTPUT, A_SQR_OUTPUT, PHASE_HISTORY, INCR_HISTORY, PHASE_HISTORY + b, INCR_HISTORY + b, oldDiscont[0][g], oldSyncDiscont[b][g],
+                       square[0][g], oldDecr[0][g], oldDecr[0][g], oldDecr[b][g], simd::ifelse(discont[0][g] == 0.0f, 1.0f, -1.0f), simd::ifelse(discont[b][g] == 0.0f, 1.0f, -1.0f));
+        applyReset(history[g], A_SAW_OUTPUT, A_SQR_OUTPUT, oldResetSteps[0][g]);
+        out[A_SAW_OUTPUT] = simd::clamp(10.0f * ((history[g].at(A_SAW_OUTPUT, 0) + chaosA.value) / (1.0f + chaosA.value) - 0.5f), -5.0f, 5.0f);
+        out[A_SQR_OUTPUT] = simd::clamp(5.0f * history[g].at(A_SQR_OUTPUT, 0), -5.0f, 5.0f);
+    }
+    if (outputsB) {
+        KHZ_PROFILE_SCOPE(PROFILE_RESIDUALS);
+        int a = b - 1;
+        float_4 flipB = simd::ifelse(discont[b][g] == 0.0f, 1.0f, -1.0f);
+        applyResiduals(history[g], B_SAW_OUTPUT, B_SQR_OUTPUT, PHASE_HISTORY + b, INCR_HISTORY + b, PHASE_HISTORY + a, INCR_HISTORY + a, oldDiscont[b][g], oldSyncDiscont[a][g],
+                       square[b][g], oldDecr[b][g], oldDecr[a][g], oldDecr[a][g], flipB, flipB);
+        applyReset(history[g], B_SAW_OUTPUT, B_SQR_OUTPUT, oldResetSteps[1][g]);
+        out[B_SAW_OUTPUT] = simd::clamp(10.0f * ((history[g].at(B_SAW_OUTPUT, 0) + chaosB.value) / (1.0f + chaosB.value) - 0.5f), -5.0f, 5.0f);
+        out[B_SQR_OUTPUT] = simd::clamp(5.0f * history[g].at(B_SQR_OUTPUT, 0), -5.0f, 5.0f);
+    }
+
+    for (int k = 0; k < n; ++k) {
+        oldDecr[k][g] = decr[k];
+        oldDiscont[k][g] = discont[k][g];
+        oldSyncDiscont[k][g] = syncDiscont[k][g];
+    }
+    for (int j = 0; j < 2; ++j) {
+        oldResetSteps[j][g] = resetSteps[j][g];
+        resetSteps[j][g] = ResetStep();
+    }
+}
+
+
+// resets oscillator 0 in the lanes of resetA and the others in the lanes of resetB, at the given offsets
+// into the coming step. the phase runs on up to that point first, so it may wrap on the way, and it's
+// set so that the step lands where the reset phase would be at its end. the jumps of A and B, and those
+// of a wrap on the way with their own offset, are kept in resetSteps for the residuals.
+void TachyonEntanglerEngine::resetOscillators(int g, float_4 resetA, float_4 resetB, float_4 offsetA, float_4 offsetB, const float_4 *incr) {
+    int b = activeSettings.oscillators - 1;
+    for (int k = 0; k <= b; ++k) {
+        float_4 reset = (k == 0) ? resetA : resetB;
+        if (!simd::movemask(reset)) {
+            continue;
+        }
+        float_4 offset = (k == 0) ? offsetA : offsetB;
+        if (k == 0 || k == b) {
+            float_4 pre = phase[k][g] + offset * incr[k];
+            float_4 wraps = simd::floor(pre);
+            float_4 wrapped = reset & (wraps != 0.0f);
+            float_4 squarePre = simd::ifelse(wraps != 0.0f, -square[k][g], square[k][g]);
+            ResetStep &step = resetSteps[(k == 0) ? 0 : 1][g];
+            step.mask = reset;
+            step.offset = simd::ifelse(reset, offset, 0.0f);
+            // where the phase crossed 1 going up, or 0 going down.
+            step.wrapOffset = simd::ifelse(wrapped, clamp01((((wraps > 0.0f) & 1.0f) - phase[k][g]) / incr[k]), 0.0f);
+            step.wrapSaw = simd::ifelse(wrapped, wraps, 0.0f);
+            step.wrapSqr = simd::ifelse(wrapped, -2.0f * squarePre, 0.0f);
+            step.saw = simd::ifelse(reset, pre - wraps, 0.0f);
+            step.sqr = simd::ifelse(reset, squarePre - 1.0f, 0.0f);
+        }
+        phase[k][g] = simd::ifelse(reset, -offset * incr[k], phase[k][g]);
+        square[k][g] = simd::ifelse(reset, 1.0f, square[k][g]);
+    }
+}
+
+
+// with oversampling, each frame is rendered as several steps of oscillators running at the oversampled
+// rate, and the outputs are decimated back down to one sample. a reset applies to the step its offset
+// falls in.
+void TachyonEntanglerEngine::renderBlock(int g, int frames, float sampleTime) {
+    int n = activeSettings.oscillators;
+    int factor = activeSettings.oversampling;
+    float_4 incrs[MAX_OSCILLATORS][BLOCK_SIZE];
+    computeIncrements(incrs, g, frames, sampleTime / factor);
+    // the chaos and sync probabilities only change once per block.
+    float_4 rand[MAX_OSCILLATORS];
+    float_4 syncProb[MAX_OSCILLATORS];
+    for (int k = 0; k < n; ++k) {
+        rand[k] = ringMix(randA[g].value, randB[g].value, k, n);
+        syncProb[k] = ringMix(syncProbA[g].value, syncProbB[g].value, k, n);
+    }
+
+    const EventQueue<BLOCK_SIZE>::Event *eventA = resetEventsA[g].begin();
+    const EventQueue<BLOCK_SIZE>::Event *eventB = resetEventsB[g].begin();
+    for (int i = 0; i < frames; ++i) {
+        // the resets of this frame, with their offsets scaled to steps.
+        float_4 resetA = float_4::zero();
+        float_4 resetB = float_4::zero();
+        float_4 offsetA = 0.0f;
+        float_4 offsetB = 0.0f;
+        if (eventA != resetEventsA[g].end() && eventA->frame == i) {
+            resetA = eventA->mask;
+            offsetA = eventA->offset * factor;
+            ++eventA;
+        }
+        if (eventB != resetEventsB[g].end() && eventB->frame == i) {
+            resetB = eventB->mask;
+            offsetB = eventB->offset * factor;
+            ++eventB;
+        }
+        bool resets = simd::movemask(resetA | resetB);
+        KHZ_PROFILE_COUNT(EVENT_RESETS, profileLanes(resetA) + profileLanes(resetB));
+
+        float_4 incr[MAX_OSCILLATORS];
+        for (int k = 0; k < n; ++k) {
+            incr[k] = incrs[k][i];
+        }
+        float_4 steps[NUM_OUTPUTS][MAX_OVERSAMPLING];
+        for (int s = 0; s < factor; ++s) {
+            if (resets) {
+                // an offset of exactly 1 falls in the last step.
+                float_4 last = (s == factor - 1) ? float_4::mask() : float_4::zero();
+                float_4 stepA = offsetA - s;
+                float_4 stepB = offsetB - s;
+                float_4 hereA = resetA & (stepA >= 0.0f) & ((stepA < 1.0f) | last);
+                float_4 hereB = resetB & (stepB >= 0.0f) & ((stepB < 1.0f) | last);
+                resetOscillators(g, hereA, hereB, stepA, stepB, incr);
+            }
+            float_4 out[NUM_OUTPUTS] = {};
+            renderSample(g, incr, rand, syncProb, out);
+            for (int j = 0; j < NUM_OUTPUTS; ++j) {
+                steps[j][s] = out[j];
+            }
+        }
+        for (int j = 0; j < NUM_OUTPUTS; ++j) {
+            bool connected = (j == A_SAW_OUTPUT || j == A_SQR_OUTPUT) ? outputsA : outputsB;
+            if (factor == 1) {
+                outputBlock[j][g][i] = steps[j][0];
+            }
+            else if (connected) {
+                KHZ_PROFILE_SCOPE(PROFILE_DECIMATION);
+                outputBlock[j][g][i] = decimators[j][g].process(steps[j], factor);
+            }
+        }
+    }
+}
+
+
+// while no output is connected there's nothing to render, so process() only calls this once per block.
+// it keeps updating the controls, to notice when an output gets connected, and keeps all phases running
+// at the current pitches. chaos and sync are left out, so the oscillators run free until they wake up,
+// at which point the histories, residuals and decimators from before the sleep are cleared.
+void TachyonEntanglerEngine::sleepBlock(float sampleTime) {
+    KHZ_PROFILE_COUNT(EVENT_SLEEPING_BLOCKS, 1);
+    takeSettings();
+    controlDivider.setDivision(activeSettings.controlInterval / BLOCK_SIZE);
+    if (controlDivider.process()) {
+        updateControls();
+    }
+    stepControls();
+    channels = 1;
+    for (int i = 0; i < NUM_INPUTS; ++i) {
+        channels = std::max(channels, inputs[i].getChannels());
+    }
+    for (int c = 0; c < channels; c += 4) {
+        int g = c / 4;
+        vOctBlockA[g][0] = inputs[A_V_OCT_INPUT].getPolyVoltageSimd<float_4>(c);
+        vOctBlockB[g][0] = inputs[B_V_OCT_INPUT].getPolyVoltageSimd<float_4>(c);
+        expFmBlockA[g][0] = inputs[A_EXP_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        expFmBlockB[g][0] = inputs[B_EXP_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        linFmBlockA[g][0] = inputs[A_LIN_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        linFmBlockB[g][0] = inputs[B_LIN_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        float_4 incrs[MAX_OSCILLATORS][BLOCK_SIZE];
+        computeIncrements(incrs, g, 1, sampleTime);
+        float_4 offsetA;
+        float_4 offsetB;
+        float_4 resetA = resetDetectorA[g].process(inputs[A_RESET_INPUT].getPolyVoltageSimd<float_4>(c), offsetA);
+        float_4 resetB = resetDetectorB[g].process(inputs[B_RESET_INPUT].getPolyVoltageSimd<float_4>(c), offsetB);
+        resetOscillators(g, resetA, resetB, 0.0f, 0.0f, incrs[0]);
+        for (int k = 0; k < activeSettings.oscillators; ++k) {
+            skipPhase(phase[k][g], square[k][g], BLOCK_SIZE * incrs[k][0]);
+        }
+    }
+    if (outputsA || outputsB) {
+        for (int g = 0; g < 4; ++g) {
+            history[g] = ResidualBuffer<float_4, NUM_HISTORIES>();
+            for (int k = 0; k < MAX_OSCILLATORS; ++k) {
+                discont[k][g] = syncDiscont[k][g] = 0.0f;
+                oldDiscont[k][g] = oldSyncDiscont[k][g] = 0.0f;
+            }
+            for (int j = 0; j < 2; ++j) {
+                resetSteps[j][g] = oldResetSteps[j][g] = ResetStep();
+            }
+            for (int j = 0; j < NUM_OUTPUTS; ++j) {
+                decimators[j][g] = OversamplingDecimator<float_4>();
+            }
+        }
+        memset(outputBlock, 0, sizeof(outputBlock));
+    }
+}
+
+
+// plays back frame pos of the output blocks.
+void TachyonEntanglerEngine::writeOutputs(int pos) {
+    for (int c = 0; c < outputChannels; c += 4) {
+        for (int i = 0; i < NUM_OUTPUTS; ++i) {
+            outputs[i].setVoltageSimd(outputBlock[i][c / 4][pos], c);
+        }
+    }
+    for (int i = 0; i < NUM_OUTPUTS; ++i) {
+        outputs[i].setChannels(outputChannels);
+    }
+}
+
+
+void TachyonEntanglerEngine::process(float sampleTime) {
+    if (!outputsA && !outputsB) {
+        if (++blockPos == BLOCK_SIZE) {
+            blockPos = 0;
+            sleepBlock(sampleTime);
+        }
+        return;
+    }
+
+    if (blockFrames > 1) {
+        writeOutputs(blockPos);
+    }
+    channels = 1;
+    for (int i = 0; i < NUM_INPUTS; ++i) {
+        channels = std::max(channels, inputs[i].getChannels());
+    }
+    for (int c = 0; c < channels; c += 4) {
+        int g = c / 4;
+        vOctBlockA[g][blockPos] = inputs[A_V_OCT_INPUT].getPolyVoltageSimd<float_4>(c);
+        vOctBlockB[g][blockPos] = inputs[B_V_OCT_INPUT].getPolyVoltageSimd<float_4>(c);
+        expFmBlockA[g][blockPos] = inputs[A_EXP_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        expFmBlockB[g][blockPos] = inputs[B_EXP_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        linFmBlockA[g][blockPos] = inputs[A_LIN_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        linFmBlockB[g][blockPos] = inputs[B_LIN_FM_INPUT].getPolyVoltageSimd<float_4>(c);
+        recordTrigger(resetDetectorA[g], resetEventsA[g], blockPos, inputs[A_RESET_INPUT].getPolyVoltageSimd<float_4>(c));
+        recordTrigger(resetDetectorB[g], resetEventsB[g], blockPos, inputs[B_RESET_INPUT].getPolyVoltageSimd<float_4>(c));
+    }
+
+    if (++blockPos < blockFrames) {
+        return;
+    }
+    int frames = blockPos;
+    blockPos = 0;
+    takeSettings();
+    controlDivider.setDivision(activeSettings.controlInterval / blockFrames);
+    if (controlDivider.process()) {
+        updateControls();
+    }
+    stepControls();
+    for (int c = 0; c < channels; c += 4) {
+        (this->*kernel)(c / 4, frames, sampleTime);
+    }
+    outputChannels = channels;
+    for (int g = 0; g < 4; ++g) {
+        resetEventsA[g].clear();
+        resetEventsB[g].clear();
+    }
+    if (frames == 1) {
+        // low latency, the frame goes out right away.
+        writeOutputs(0);
+    }
+    if (frames != blockFrames) {
+        // the latency changed, and the block that was just rendered is too short or too late to play.
+        memset(outputBlock, 0, sizeof(outputBlock));
+    }
+}
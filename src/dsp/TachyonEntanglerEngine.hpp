@@ -0,0 +1,247 @@
+#pragma once
+#include "math.hpp"
+#include "events.hpp"
+#include "snapshot.hpp"
+#include "signal.hpp"
+#include "profile.hpp"
+#include "cpu.hpp"
+
+
+// the ids of the Tachyon Entangler's knobs and ports and the limits of its settings, shared by the
+// engine and the module.
+struct TachyonEntanglerIds {
+    enum ParamIds {
+        A_OCTAVE_PARAM,
+        A_COARSE_PARAM,
+        A_FINE_PARAM,
+        B_RATIO_PARAM,
+        A_EXP_FM_PARAM,
+        A_LIN_FM_PARAM,
+        B_EXP_FM_PARAM,
+        B_LIN_FM_PARAM,
+        A_CHAOS_PARAM,
+        A_SYNC_PROB_PARAM,
+        B_CHAOS_PARAM,
+        B_SYNC_PROB_PARAM,
+        A_CHAOS_MOD_PARAM,
+        A_SYNC_PROB_MOD_PARAM,
+        B_CHAOS_MOD_PARAM,
+        B_SYNC_PROB_MOD_PARAM,
+        NUM_PARAMS
+    };
+    enum InputIds {
+        A_EXP_FM_INPUT,
+        A_LIN_FM_INPUT,
+        B_EXP_FM_INPUT,
+        B_LIN_FM_INPUT,
+        A_CHAOS_INPUT,
+        A_SYNC_PROB_INPUT,
+        B_CHAOS_INPUT,
+        B_SYNC_PROB_INPUT,
+        A_RESET_INPUT,
+        B_RESET_INPUT,
+        A_V_OCT_INPUT,
+        B_V_OCT_INPUT,
+        NUM_INPUTS
+    };
+    enum OutputIds {
+        A_SAW_OUTPUT,
+        A_SQR_OUTPUT,
+        B_SAW_OUTPUT,
+        B_SQR_OUTPUT,
+        NUM_OUTPUTS
+    };
+    static const int MAX_OSCILLATORS = 8;
+    static const int BLOCK_SIZE = 16;
+    static const int MAX_OVERSAMPLING = 8;
+};
+
+
+// the Tachyon Entangler's DSP, without Rack. like PalmLoopEngine, the host points inputs and outputs at
+// its voltages, takes the knobs into knobs whenever controlsDue(), and calls process() once per frame.
+// the blocks delay the outputs by BLOCK_SIZE frames, unless Settings::lowLatency is set.
+struct TachyonEntanglerEngine : TachyonEntanglerIds {
+    // rows of the residual buffer. the first ones are the naive waveforms, indexed by their output ids,
+    // followed by the phase and increment histories of each oscillator of the ring.
+    enum HistoryIds {
+        PHASE_HISTORY = NUM_OUTPUTS,
+        INCR_HISTORY = PHASE_HISTORY + MAX_OSCILLATORS,
+        NUM_HISTORIES = INCR_HISTORY + MAX_OSCILLATORS
+    };
+    // profile counters, see dsp/profile.hpp. the first ones time sections, the rest count events per
+    // voice.
+    enum ProfileIds {
+        PROFILE_CONTROLS,
+        PROFILE_INCREMENTS,
+        PROFILE_PHASES,
+        PROFILE_SYNC,
+        PROFILE_RESIDUALS,
+        PROFILE_DECIMATION,
+        EVENT_DISCONTS,
+        EVENT_CHAOS_JUMPS,
+        EVENT_SYNCS,
+        EVENT_COINCIDENT_SYNCS,
+        EVENT_PITCH_CLAMPS,
+        EVENT_RESETS,
+        EVENT_SLEEPING_BLOCKS,
+        NUM_PROFILE_IDS
+    };
+
+    PolySignal inputs[NUM_INPUTS];
+    PolySignal outputs[NUM_OUTPUTS];
+    ParamSnapshot<NUM_PARAMS> knobs;
+
+    // the oscillators form a ring, in which each one can be synced by the one before it. oscillator 0
+    // is A and the last one is B, so with the default of two oscillators A and B sync each other, and
+    // with more the oscillators in between take controls interpolated between A's and B's, see
+    // ringMix(). only A and B have outputs.
+    //
+    // voice state is stored four voices to a float_4, so index [k][g] holds channels 4g to 4g + 3 of
+    // oscillator k. the discontinuity flags hold 1, -1 or 0 per lane, like the integer flags of the
+    // monophonic version. syncDiscont[k] is the discontinuity of oscillator k that syncs oscillator k + 1.
+    float_4 phase[MAX_OSCILLATORS][4] = {};
+    float_4 square[MAX_OSCILLATORS][4];
+    float_4 oldDecr[MAX_OSCILLATORS][4] = {};
+    float_4 discont[MAX_OSCILLATORS][4] = {};
+    float_4 syncDiscont[MAX_OSCILLATORS][4] = {};
+    float_4 oldDiscont[MAX_OSCILLATORS][4] = {};
+    float_4 oldSyncDiscont[MAX_OSCILLATORS][4] = {};
+
+    // the naive waveforms of A and B, and the phase and increment histories of every oscillator.
+    ResidualBuffer<float_4, NUM_HISTORIES> history[4];
+
+    // with chaos or nested syncs, discontinuities can come closer together than the polyblep window,
+    // which aliases at high pitches. oversampling (see Settings) gives them more room.
+    OversamplingDecimator<float_4> decimators[NUM_OUTPUTS][4];
+
+    // process() records the audio-rate inputs into these blocks and plays back the outputs of the
+    // last rendered block, so the outputs are delayed by blockFrames samples. in low latency mode the
+    // blocks are a single frame long, which is rendered and played back in the same process().
+    float_4 vOctBlockA[4][BLOCK_SIZE] = {};
+    float_4 vOctBlockB[4][BLOCK_SIZE] = {};
+    float_4 expFmBlockA[4][BLOCK_SIZE] = {};
+    float_4 expFmBlockB[4][BLOCK_SIZE] = {};
+    float_4 linFmBlockA[4][BLOCK_SIZE] = {};
+    float_4 linFmBlockB[4][BLOCK_SIZE] = {};
+    float_4 outputBlock[NUM_OUTPUTS][4][BLOCK_SIZE] = {};
+    int blockPos = 0;
+    int blockFrames = BLOCK_SIZE;
+    int channels = 1;
+    int outputChannels = 1;
+
+    // control-rate values. the knobs are read every controlInterval samples, and the values ramp to
+    // them once per block in between. the chaos and sync probability inputs are treated as
+    // control-rate as well.
+    ControlRamp<float> centerPitch = 8.03136f;
+    ControlRamp<float> ratioB;
+    ControlRamp<float> expFmA;
+    ControlRamp<float> expFmB;
+    ControlRamp<float> linFmA;
+    ControlRamp<float> linFmB;
+    ControlRamp<float> chaosA;
+    ControlRamp<float> chaosB;
+    ControlRamp<float_4> randA[4];
+    ControlRamp<float_4> randB[4];
+    ControlRamp<float_4> syncProbA[4];
+    ControlRamp<float_4> syncProbB[4];
+    bool expFmConnectedA = false;
+    bool expFmConnectedB = false;
+    bool linFmConnectedA = false;
+    bool linFmConnectedB = false;
+    bool vOctConnectedB = false;
+    // with neither oscillator's outputs connected the engine sleeps, see sleepBlock(). they start out
+    // connected, so the engine is awake until the first control update.
+    bool outputsA = true;
+    bool outputsB = true;
+
+    float log2sampleFreq = 15.4284f;
+
+    // the context menu settings. the UI thread hands a copy to the audio thread with publishSettings(),
+    // which process() takes into activeSettings at the start of a block, so a setting never changes in
+    // the middle of rendering one.
+    struct Settings {
+        // one of the Exp2Accuracy tiers.
+        int pitchAccuracy = EXP2_HIGH;
+        int controlInterval = BLOCK_SIZE;
+        // 1, 2, 4 or 8 times.
+        int oversampling = 1;
+        // 2 to MAX_OSCILLATORS.
+        int oscillators = 2;
+        // the seed of the random generators. the engine reseeds them when seedGeneration changes, so
+        // the UI thread never writes to the generators the audio thread draws from.
+        uint32_t seed = 0;
+        int seedGeneration = 0;
+        // renders every frame on its own instead of in blocks of BLOCK_SIZE, for feedback and
+        // cross-modulation patches, at a higher cpu cost.
+        int lowLatency = 0;
+    };
+    Settings activeSettings;
+    TripleBuffer<Settings> settingsBuffer;
+    ControlDivider controlDivider;
+
+    // each voice group draws its chaos and sync decisions from its own generator.
+    Xorshift4 rng[4];
+
+    // A's reset input resets oscillator 0, and B's resets all the others. the resets of the current
+    // block are recorded with their offset into the frame, so the kernel can place them between steps.
+    TriggerDetector resetDetectorA[4];
+    TriggerDetector resetDetectorB[4];
+    EventQueue<BLOCK_SIZE> resetEventsA[4];
+    EventQueue<BLOCK_SIZE> resetEventsB[4];
+
+    // the jumps of A's and B's outputs (index 0 and 1) where they were reset during a step, kept like
+    // the discont flags, so the residuals are applied from the history in the step after. the wrap
+    // fields hold the jumps of a wrap before the reset in the same step, which are zero in the other
+    // lanes.
+    struct ResetStep {
+        float_4 mask = float_4::zero();
+        float_4 offset = 0.0f;
+        float_4 saw = 0.0f;
+        float_4 sqr = 0.0f;
+        float_4 wrapOffset = 0.0f;
+        float_4 wrapSaw = 0.0f;
+        float_4 wrapSqr = 0.0f;
+    };
+    ResetStep resetSteps[2][4];
+    ResetStep oldResetSteps[2][4];
+
+    // renderBlock() compiled for the CPU's level, see dsp/cpu.hpp.
+    typedef void (TachyonEntanglerEngine::*Kernel)(int g, int frames, float sampleTime);
+    Kernel kernel;
+
+#ifdef KHZ_PROFILE
+    Profile<NUM_PROFILE_IDS> profile = {"control updates", "increments", "phase advance", "sync correction", "residuals",
+                                        "decimation", "discontinuities", "chaos jumps", "syncs", "syncs on a discontinuity",
+                                        "pitch clamps", "resets", "sleeping blocks"};
+#endif
+
+    TachyonEntanglerEngine();
+    void setSampleTime(float sampleTime);
+    void publishSettings(const Settings &settings);
+    // whether the next process() reads knobs, i.e. ends a block. the engine always sleeps in blocks of
+    // BLOCK_SIZE.
+    bool controlsDue() const {
+        return blockPos == ((outputsA || outputsB) ? blockFrames : BLOCK_SIZE) - 1;
+    }
+    void process(float sampleTime);
+
+    void updateControls();
+    void stepControls();
+    void computeIncrements(float_4 (*incrs)[BLOCK_SIZE], int g, int frames, float sampleTime);
+    void sync(int g, int from, int to, const float_4 *incr);
+    void renderSample(int g, const float_4 *incr, const float_4 *rand, const float_4 *syncProb, float_4 *out);
+    void renderBlock(int g, int frames, float sampleTime);
+    KHZ_KERNEL_SSE4 void renderBlockSse4(int g, int frames, float sampleTime) {
+        renderBlock(g, frames, sampleTime);
+    }
+    KHZ_KERNEL_AVX2 void renderBlockAvx2(int g, int frames, float sampleTime) {
+        renderBlock(g, frames, sampleTime);
+    }
+    KHZ_KERNEL_AVX512 void renderBlockAvx512(int g, int frames, float sampleTime) {
+        renderBlock(g, frames, sampleTime);
+    }
+    void resetOscillators(int g, float_4 resetA, float_4 resetB, float_4 offsetA, float_4 offsetB, const float_4 *incr);
+    void sleepBlock(float sampleTime);
+    void takeSettings();
+    void writeOutputs(int pos);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+
+// the instruction set levels the hot kernels are compiled for. the plugin itself is built for Rack's
+// baseline (-march=nehalem, i.e. SSE4.2), and init() picks the best level the CPU supports. the voice
+// state stays in float_4, four voices to a group, so the higher levels don't widen the vectors. they
+// get the VEX/EVEX encodings, whose three-operand forms save the register copies, and with AVX-512,
+// ternary logic for the lane masks. the build turns off contraction into fused multiply-adds, so every
+// level renders exactly the same samples; the chaos of the Tachyon Entangler would otherwise turn a
+// rounding difference into a different output.
+enum CpuLevel {
+    CPU_SSE4,
+    CPU_AVX2,
+    CPU_AVX512,
+    NUM_CPU_LEVELS
+};
+
+
+// the level the modules select their kernels for. it's CPU_SSE4 until init() sets it, so a host that
+// doesn't call it (e.g. the benchmarks) gets kernels that run anywhere.
+inline int &cpuLevel() {
+    static int level = CPU_SSE4;
+    return level;
+}
+
+
+inline const char *cpuLevelName(int level) {
+    static const char *names[] = {"SSE4.2", "AVX2", "AVX-512"};
+    return names[level];
+}
+
+
+// the best level this CPU (and OS, which has to save the wider registers) supports.
+inline int detectCpuLevel() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq")) {
+        return CPU_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return CPU_AVX2;
+    }
+#endif
+    return CPU_SSE4;
+}
+
+
+// attributes for a kernel's entry point at each level. flatten inlines the kernel's whole call tree
+// into it, so everything it calls is compiled for that level too. a module gives each kernel one entry
+// point per level, which just calls the kernel, and selects between them with cpuLevel().
+#if defined(__x86_64__) || defined(__i386__)
+#define KHZ_KERNEL_SSE4 __attribute__((flatten))
+#define KHZ_KERNEL_AVX2 __attribute__((flatten, target("avx2,fma")))
+#define KHZ_KERNEL_AVX512 __attribute__((flatten, target("avx512f,avx512vl,avx512dq,avx2,fma")))
+#else
+#define KHZ_KERNEL_SSE4 __attribute__((flatten))
+#define KHZ_KERNEL_AVX2 __attribute__((flatten))
+#define KHZ_KERNEL_AVX512 __attribute__((flatten))
+#endif
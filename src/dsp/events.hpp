@@ -0,0 +1,73 @@
+#pragma once
+#include "math.hpp"
+
+
+// a schmitt trigger that also reports where between two samples each lane crossed, so block kernels
+// can place the event between samples. like rack's, it goes high at 1 V and low again at 0 V. the
+// crossing is found by linear interpolation between the previous and the current input. also like
+// rack's, it starts out high, so an input that's already high when the module is added doesn't
+// trigger.
+struct TriggerDetector {
+    float_4 high = float_4::mask();
+    float_4 previous = 0.0f;
+
+    // returns the mask of the lanes that triggered, and sets offset to where they crossed 1 V, from 0
+    // at the previous sample to 1 at this one.
+    float_4 process(float_4 in, float_4 &offset) {
+        float_4 triggered = ~high & (in >= 1.0f);
+        high = (in >= 1.0f) | (high & ~(in <= 0.0f));
+        offset = rack::simd::ifelse(triggered, clamp01((1.0f - previous) / (in - previous)), 0.0f);
+        previous = in;
+        return triggered;
+    }
+
+    // the same without the offset, for inputs that only toggle a state.
+    float_4 process(float_4 in) {
+        float_4 triggered = ~high & (in >= 1.0f);
+        high = (in >= 1.0f) | (high & ~(in <= 0.0f));
+        return triggered;
+    }
+};
+
+
+// the trigger events of one voice group in the current block, in order of frame. process() records
+// them as the inputs come in, and the block kernel applies each one at its frame and offset, rather
+// than polling a trigger every sample. there's at most one event per frame.
+template <int CAPACITY>
+struct EventQueue {
+    struct Event {
+        int frame;
+        // the lanes with an event at this frame, and where in the frame it happened, as from
+        // TriggerDetector.
+        float_4 mask;
+        float_4 offset;
+    };
+    Event events[CAPACITY];
+    int size = 0;
+
+    void push(int frame, float_4 mask, float_4 offset) {
+        if (size < CAPACITY) {
+            events[size++] = {frame, mask, offset};
+        }
+    }
+    void clear() {
+        size = 0;
+    }
+    const Event *begin() const {
+        return events;
+    }
+    const Event *end() const {
+        return events + size;
+    }
+};
+
+
+// feeds frame of a trigger input to its detector, and queues an event for the lanes that triggered.
+template <int CAPACITY>
+void recordTrigger(TriggerDetector &detector, EventQueue<CAPACITY> &queue, int frame, float_4 in) {
+    float_4 offset;
+    float_4 triggered = detector.process(in, offset);
+    if (rack::simd::movemask(triggered)) {
+        queue.push(frame, triggered, offset);
+    }
+}
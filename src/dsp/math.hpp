@@ -1,72 +1,437 @@
-#include <array>
+#pragma once
+#include "simd.hpp"
+#include <stdint.h>
+#include <string.h>
 
 
-using std::array;
+using rack::simd::float_4;
 
 
-// four point, fourth-order b-spline polyblep, from:
+// circular buffers holding the last N samples of B signals of an oscillator, e.g. its waveforms
+// before the residuals are added. advancing moves the read position instead of shifting every
+// sample down by one, so at(b, 0) is the oldest sample of signal b (the output) and at(b, N - 1) the
+// newest, which is overwritten after each advance. all signals of an oscillator share one head, so
+// its whole history lives in a single struct. N is the length of the residual kernels, a power of two.
+template <typename T, int B, int N = 4>
+struct ResidualBuffer {
+    T buffer[B][N] = {};
+    int head = 0;
+
+    void advance() {
+        head = (head + 1) & (N - 1);
+    }
+    T &at(int b, int i) {
+        return buffer[b][(head + i) & (N - 1)];
+    }
+    void clear(int b) {
+        for (int i = 0; i < N; ++i) {
+            buffer[b][i] = T(0.0f);
+        }
+    }
+};
+
+
+// branchless clamp to [0, 1], for both float and float_4.
+template <typename T>
+T clamp01(T x) {
+    return rack::simd::fmin(rack::simd::fmax(x, T(0.0f)), T(1.0f));
+}
+
+
+// n-point b-spline polyblep and polyblamp residuals, generalizing the four point kernels from:
 // Välimäki, Pekonen, Nam. "Perceptually informed synthesis of bandlimited
 // classical waveforms using integrated polynomial interpolation"
-inline void polyblep4(array<float, 4> &buffer, float d, float u) {
-    if (d > 1.0f) {
-        d = 1.0f;
-    }
-    else if (d < 0.0f) {
-        d = 0.0f;
-    }
-    
-    float d2 = d * d;
-    float d3 = d2 * d;
-    float d4 = d3 * d;
-    float dd3 = 0.16667 * (d + d3);
-    float cd2 = 0.041667 + 0.25 * d2;
-    float d4_1 = 0.041667 * d4;
-    
-    buffer[3] += u * (d4_1);
-    buffer[2] += u * (cd2 + dd3 - 0.125 * d4);
-    buffer[1] += u * (-0.5 + 0.66667 * d - 0.33333 * d3 + 0.125 * d4);
-    buffer[0] += u * (-cd2 + dd3 - d4_1);
+// Esqueda, Välimäki, Bilbao. "Rounding Corners with BLAMP".
+// the step and ramp are smoothed by integrals of an order N b-spline, so longer kernels reject more
+// aliasing, at N / 2 samples of latency. each row holds the polynomial in d for one buffer sample,
+// oldest first, lowest power first.
+template <int N>
+struct BSplineResidual;
+
+template <>
+struct BSplineResidual<2> {
+    typedef float Blep[2][3];
+    typedef float Blamp[2][4];
+    static const Blep &blep() {
+        static const Blep coeffs = {
+            {-0.5f, 1.0f, -0.5f},
+            {0.0f, 0.0f, 0.5f}};
+        return coeffs;
+    }
+    static const Blamp &blamp() {
+        static const Blamp coeffs = {
+            {0.16666667f, -0.5f, 0.5f, -0.16666667f},
+            {0.0f, 0.0f, 0.0f, 0.16666667f}};
+        return coeffs;
+    }
+};
+
+template <>
+struct BSplineResidual<4> {
+    typedef float Blep[4][5];
+    typedef float Blamp[4][6];
+    static const Blep &blep() {
+        static const Blep coeffs = {
+            {-0.041666667f, 0.16666667f, -0.25f, 0.16666667f, -0.041666667f},
+            {-0.5f, 0.66666667f, 0.0f, -0.33333333f, 0.125f},
+            {0.041666667f, 0.16666667f, 0.25f, 0.16666667f, -0.125f},
+            {0.0f, 0.0f, 0.0f, 0.0f, 0.041666667f}};
+        return coeffs;
+    }
+    static const Blamp &blamp() {
+        static const Blamp coeffs = {
+            {0.0083333333f, -0.041666667f, 0.083333333f, -0.083333333f, 0.041666667f, -0.0083333333f},
+            {0.23333333f, -0.5f, 0.33333333f, 0.0f, -0.083333333f, 0.025f},
+            {0.0083333333f, 0.041666667f, 0.083333333f, 0.083333333f, 0.041666667f, -0.025f},
+            {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0083333333f}};
+        return coeffs;
+    }
+};
+
+template <>
+struct BSplineResidual<8> {
+    typedef float Blep[8][9];
+    typedef float Blamp[8][10];
+    static const Blep &blep() {
+        static const Blep coeffs = {
+            {-2.4801587e-05f, 0.00019841270f, -0.00069444444f, 0.0013888889f, -0.0017361111f, 0.0013888889f, -0.00069444444f, 0.00019841270f, -2.4801587e-05f},
+            {-0.0061507937f, 0.023809524f, -0.038888889f, 0.033333333f, -0.013888889f, 0.0f, 0.0027777778f, -0.0011904762f, 0.00017361111f},
+            {-0.11262401f, 0.23630952f, -0.17013889f, 0.020833333f, 0.032986111f, -0.0125f, -0.0034722222f, 0.0029761905f, -0.00052083333f},
+            {-0.5f, 0.47936508f, 0.0f, -0.11111111f, 0.0f, 0.022222222f, 0.0f, -0.0039682540f, 0.00086805556f},
+            {0.11262401f, 0.23630952f, 0.17013889f, 0.020833333f, -0.032986111f, -0.0125f, 0.0034722222f, 0.0029761905f, -0.00086805556f},
+            {0.0061507937f, 0.023809524f, 0.038888889f, 0.033333333f, 0.013888889f, 0.0f, -0.0027777778f, -0.0011904762f, 0.00052083333f},
+            {2.4801587e-05f, 0.00019841270f, 0.00069444444f, 0.0013888889f, 0.0017361111f, 0.0013888889f, 0.00069444444f, 0.00019841270f, -0.00017361111f},
+            {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 2.4801587e-05f}};
+        return coeffs;
+    }
+    static const Blamp &blamp() {
+        static const Blamp coeffs = {
+            {2.7557319e-06f, -2.4801587e-05f, 9.9206349e-05f, -0.00023148148f, 0.00034722222f, -0.00034722222f, 0.00023148148f, -9.9206349e-05f, 2.4801587e-05f, -2.7557319e-06f},
+            {0.0013888889f, -0.0061507937f, 0.011904762f, -0.012962963f, 0.0083333333f, -0.0027777778f, 0.0f, 0.00039682540f, -0.00014880952f, 1.9290123e-05f},
+            {0.043030754f, -0.11262401f, 0.11815476f, -0.056712963f, 0.0052083333f, 0.0065972222f, -0.0020833333f, -0.00049603175f, 0.00037202381f, -5.7870370e-05f},
+            {0.32782187f, -0.5f, 0.23968254f, 0.0f, -0.027777778f, 0.0f, 0.0037037037f, 0.0f, -0.00049603175f, 9.6450617e-05f},
+            {0.043030754f, 0.11262401f, 0.11815476f, 0.056712963f, 0.0052083333f, -0.0065972222f, -0.0020833333f, 0.00049603175f, 0.00037202381f, -9.6450617e-05f},
+            {0.0013888889f, 0.0061507937f, 0.011904762f, 0.012962963f, 0.0083333333f, 0.0027777778f, 0.0f, -0.00039682540f, -0.00014880952f, 5.7870370e-05f},
+            {2.7557319e-06f, 2.4801587e-05f, 9.9206349e-05f, 0.00023148148f, 0.00034722222f, 0.00034722222f, 0.00023148148f, 9.9206349e-05f, 2.4801587e-05f, -1.9290123e-05f},
+            {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 2.7557319e-06f}};
+        return coeffs;
+    }
+};
+
+
+// adds u times the residual polynomials in coeffs, evaluated at d, to the samples of signal b. T is
+// float or float_4. in the vector version, lanes with u == 0 are left untouched.
+template <typename T, int B, int N, int P>
+void addResidual(ResidualBuffer<T, B, N> &residuals, int b, T d, T u, const float (&coeffs)[N][P]) {
+    d = clamp01(d);
+    for (int j = 0; j < N; ++j) {
+        T r = coeffs[j][P - 1];
+        for (int p = P - 2; p >= 0; --p) {
+            r = r * d + coeffs[j][p];
+        }
+        residuals.at(b, j) += u * r;
+    }
 }
 
 
-// four point, fourth-order b-spline polyblamp, from:
-// Esqueda, Välimäki, Bilbao. "Rounding Corners with BLAMP".
-inline void polyblamp4(array<float, 4> &buffer, float d, float u) {
-    if (d > 1.0f) {
-        d = 1.0f;
-    }
-    else if (d < 0.0f) {
-        d = 0.0f;
-    }
-    
-    float d2 = d * d;
-    float d3 = d2 * d;
-    float d4 = d3 * d;
-    float d5 = d4 * d;
-    float d5_1 = 0.0083333 * d5;
-    float d5_2 = 0.025 * d5;
-    
-    buffer[3] += u * (d5_1);
-    buffer[2] += u * (0.0083333 + 0.083333 * (d2 + d3) + 0.041667 * (d + d4) - d5_2);
-    buffer[1] += u * (0.23333 - 0.5 * d + 0.33333 * d2 - 0.083333 * d4 + d5_2);
-    buffer[0] += u * (0.0083333 + 0.041667 * (d4 - d) + 0.083333 * (d2 - d3) - d5_1);
+// the kernel length follows the buffer, so a shorter buffer is both cheaper and lower latency.
+template <typename T, int B, int N>
+void polyblep(ResidualBuffer<T, B, N> &residuals, int b, T d, T u) {
+    addResidual(residuals, b, d, u, BSplineResidual<N>::blep());
+}
+
+
+template <typename T, int B, int N>
+void polyblamp(ResidualBuffer<T, B, N> &residuals, int b, T d, T u) {
+    addResidual(residuals, b, d, u, BSplineResidual<N>::blamp());
 }
 
 
 // fast sine calculation. modified from the Reaktor 6 core library.
-// takes a [0, 1] range and folds it to a triangle on a [0, 0.5] range.
-inline float sin_01(float t) {
-    if (t > 1.0f) {
-        t = 1.0f;
+// takes a [0, 1] range and folds it to a triangle on a [0, 0.5] range. the fold is a select rather
+// than a branch, so it works per lane for float_4.
+template <typename T>
+T sin_01(T t) {
+    t = rack::simd::ifelse(t > 0.5f, 1.0f - t, t);
+    t = rack::simd::fmin(rack::simd::fmax(t, T(0.0f)), T(0.5f));
+    t = 2.0f * t - 0.5f;
+    T t2 = t * t;
+    t = (((-0.540347f * t2 + 2.53566f) * t2 - 5.16651f) * t2 + 3.14159f) * t;
+    return t;
+}
+
+
+// the same wave as sin_01, -cos(2 pi t), tabulated over one cycle. at 4 kB it stays in the L1 cache,
+// and there's a single instance shared by every voice of every module. a sine has no harmonics to
+// band-limit, so unlike a table of a saw there's no need for a mipmap of tables per octave. the
+// worst-case error is 5e-6 with linear and 3e-7 with cubic interpolation, against 8e-6 for sin_01.
+// without a gather instruction the four lookups per float_4 cost more than sin_01's polynomial, so
+// the table is for purity rather than speed.
+struct SineTable {
+    static const int SIZE = 1024;
+    // points -1 to SIZE + 2, so the four points around any t in [0, 1] are in range.
+    float values[SIZE + 4];
+
+    SineTable() {
+        for (int i = 0; i < SIZE + 4; ++i) {
+            values[i] = -std::cos(2.0 * M_PI * (i - 1) / SIZE);
+        }
     }
-    else if (t > 0.5) {
-        t = 1.0f - t;
+
+    // the table is built on the first call, so call it once from the UI thread, e.g. in a module's
+    // constructor, rather than first in process().
+    static const SineTable &shared() {
+        static const SineTable table;
+        return table;
     }
-    else if (t < 0.0f) {
-        t = 0.0f;
+
+    // loads the points i - 1 to i + 2 around t for each lane, one float_4 per point, and sets frac to
+    // the position between points i and i + 1. each lane's four points are loaded at once and then
+    // transposed into one vector per point.
+    void gather(float_4 t, float_4 *points, float_4 &frac) const {
+        float_4 x = clamp01(t) * (float) SIZE;
+        __m128i i = _mm_cvttps_epi32(x.v);
+        frac = x - float_4(_mm_cvtepi32_ps(i));
+        int32_t index[4];
+        _mm_storeu_si128((__m128i *) index, i);
+        __m128 p0 = _mm_loadu_ps(&values[index[0]]);
+        __m128 p1 = _mm_loadu_ps(&values[index[1]]);
+        __m128 p2 = _mm_loadu_ps(&values[index[2]]);
+        __m128 p3 = _mm_loadu_ps(&values[index[3]]);
+        _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+        points[0] = float_4(p0);
+        points[1] = float_4(p1);
+        points[2] = float_4(p2);
+        points[3] = float_4(p3);
     }
-    t = 2.0f * t - 0.5f;
-    float t2 = t * t;
-    t = (((-0.540347 * t2 + 2.53566) * t2 - 5.16651) * t2 + 3.14159) * t;
-    return t;
+
+    float_4 linear(float_4 t) const {
+        float_4 p[4], f;
+        gather(t, p, f);
+        return p[1] + f * (p[2] - p[1]);
+    }
+
+    // catmull-rom spline through the four points around t.
+    float_4 cubic(float_4 t) const {
+        float_4 p[4], f;
+        gather(t, p, f);
+        float_4 c1 = 0.5f * (p[2] - p[0]);
+        float_4 c2 = p[0] - 2.5f * p[1] + 2.0f * p[2] - 0.5f * p[3];
+        float_4 c3 = 0.5f * (p[3] - p[0]) + 1.5f * (p[1] - p[2]);
+        return ((c3 * f + c2) * f + c1) * f + p[1];
+    }
+};
+
+
+// the sum of the four lanes.
+inline float horizontalSum(float_4 x) {
+    return (x[0] + x[1]) + (x[2] + x[3]);
+}
+
+
+// advances a phase in [0, 1) by several samples' worth of increments at once and wraps it back into
+// range, flipping the square once per wrap. it doesn't render anything, so it's for keeping a
+// sleeping oscillator running at next to no cost.
+inline void skipPhase(float_4 &phase, float_4 &square, float_4 advance) {
+    phase += advance;
+    float_4 wraps = rack::simd::floor(phase);
+    phase -= wraps;
+    float_4 odd = wraps - 2.0f * rack::simd::floor(0.5f * wraps) != 0.0f;
+    square = rack::simd::ifelse(odd, -square, square);
+}
+
+
+// a control-rate value that moves linearly to its target in a given number of steps, so knob
+// changes read at a slow control rate don't turn into zipper noise. with one step it jumps straight
+// to the target.
+template <typename T>
+struct ControlRamp {
+    T value;
+    T target;
+    T delta;
+    int steps = 0;
+
+    ControlRamp(float init = 0.0f) : value(init), target(init), delta(0.0f) {}
+
+    void setTarget(T t, int n) {
+        target = t;
+        delta = (target - value) / (float) n;
+        steps = n;
+    }
+    T process() {
+        if (steps > 0) {
+            --steps;
+            value = (steps > 0) ? value + delta : target;
+        }
+        return value;
+    }
+};
+
+
+// fires once every division calls of process(), to time the control updates. it works like rack's
+// ClockDivider, which the engines can't use, since they also build without Rack.
+struct ControlDivider {
+    int clock = 0;
+    int division = 1;
+
+    void setDivision(int d) {
+        division = d;
+    }
+    int getDivision() const {
+        return division;
+    }
+    bool process() {
+        if (++clock >= division) {
+            clock = 0;
+            return true;
+        }
+        return false;
+    }
+};
+
+
+// accuracy tiers for exp2Approx, from exact to cheapest. the bounds are the worst-case tuning errors
+// of the polynomials over a whole octave.
+enum Exp2Accuracy {
+    EXP2_EXACT,     // simd::pow
+    EXP2_HIGH,      // fifth order, below 0.002 cents, about the precision of a float
+    EXP2_MEDIUM,    // third order, below 0.2 cents
+    EXP2_LOW,       // second order, below 5 cents
+    NUM_EXP2_ACCURACIES
+};
+
+
+// 2^i for a whole number i in [-126, 127], written straight into the exponent bits.
+inline float exp2Int(float i) {
+    int32_t bits = ((int32_t) i + 127) << 23;
+    float y;
+    memcpy(&y, &bits, sizeof(y));
+    return y;
+}
+
+
+inline float_4 exp2Int(float_4 i) {
+    __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(i.v), _mm_set1_epi32(127)), 23);
+    return float_4(_mm_castsi128_ps(bits));
 }
+
+
+// 2^x, split into 2^floor(x), which is exact, and a polynomial for the fractional part. the
+// polynomials are fitted for minimum relative error under the constraint p(0) = 1 and p(1) = 2,
+// so the approximation stays continuous across octaves.
+template <typename T>
+T exp2Approx(T x, int accuracy) {
+    if (accuracy == EXP2_EXACT) {
+        return rack::simd::pow(2.0f, x);
+    }
+    x = rack::simd::fmin(rack::simd::fmax(x, T(-126.0f)), T(127.0f));
+    T i = rack::simd::floor(x);
+    T f = x - i;
+    T p;
+    switch (accuracy) {
+        case EXP2_MEDIUM:
+            p = ((0.07826797f * f + 0.22630768f) * f + 0.69542435f) * f + 1.0f;
+            break;
+        case EXP2_LOW:
+            p = (0.33976603f * f + 0.66023397f) * f + 1.0f;
+            break;
+        default:
+            p = ((((0.0018793186f * f + 0.008990995f) * f + 0.055818676f) * f + 0.24015927f) * f + 0.69315174f) * f + 1.0f;
+            break;
+    }
+    return p * exp2Int(i);
+}
+
+
+// 2x half-band decimator. a 31-tap fir, flat within 0.01 dB up to 0.2 of the input rate and 57 dB
+// down from 0.3. every other coefficient of a half-band filter is zero, so in polyphase form the
+// even samples only pass through a delay with gain 0.5, and each output costs eight multiplies for
+// the odd samples. the odd history is written twice, so its taps can be read without wrapping.
+template <typename T>
+struct HalfBandDecimator {
+    static const int K = 8;
+    T oddHistory[4 * K] = {};
+    T evenHistory[K - 1] = {};
+    int oddPos = 0;
+    int evenPos = 0;
+
+    // x0 and x1 are two consecutive input samples, x0 the older one.
+    T process(T x0, T x1) {
+        static const float coeffs[K] = {0.315678068f, -0.098417824f, 0.0515222789f, -0.0297817193f,
+                                        0.0172066109f, -0.00942533995f, 0.00464848271f, -0.00210754002f};
+        if (--oddPos < 0) {
+            oddPos = 2 * K - 1;
+        }
+        oddHistory[oddPos] = x1;
+        oddHistory[oddPos + 2 * K] = x1;
+        const T *h = &oddHistory[oddPos];
+        T y = 0.5f * evenHistory[evenPos];
+        for (int k = 0; k < K; ++k) {
+            y += coeffs[k] * (h[K - 1 - k] + h[K + k]);
+        }
+        evenHistory[evenPos] = x0;
+        if (++evenPos == K - 1) {
+            evenPos = 0;
+        }
+        return y;
+    }
+};
+
+
+// decimates 2x, 4x or 8x oversampled signals with a cascade of half-band stages, each running at
+// half the rate of the previous one. stage s takes the signal from 2^(s + 1) down to 2^s times the
+// output rate, so a stage keeps its history when the factor changes.
+template <typename T>
+struct OversamplingDecimator {
+    HalfBandDecimator<T> stages[3];
+
+    // decimates the oversampling samples in x, which are overwritten in the process.
+    T process(T *x, int oversampling) {
+        for (int n = oversampling; n > 1; n /= 2) {
+            HalfBandDecimator<T> &stage = stages[(n >= 8) ? 2 : (n >= 4) ? 1 : 0];
+            for (int i = 0; i < n / 2; ++i) {
+                x[i] = stage.process(x[2 * i], x[2 * i + 1]);
+            }
+        }
+        return x[0];
+    }
+};
+
+
+// four independent xorshift128 generators, one per lane, so each voice of a voice group draws its
+// own random numbers in parallel. from:
+// Marsaglia. "Xorshift RNGs"
+struct Xorshift4 {
+    __m128i x, y, z, w;
+
+    Xorshift4() {
+        seed(0);
+    }
+
+    // spreads seed over the lanes and state words with a splitmix32 style hash. w is made odd, so no
+    // lane's state is ever all zero.
+    void seed(uint32_t seed) {
+        uint32_t s[16];
+        for (int i = 0; i < 16; ++i) {
+            uint32_t v = (seed += 0x9e3779b9);
+            v = (v ^ (v >> 16)) * 0x85ebca6b;
+            v = (v ^ (v >> 13)) * 0xc2b2ae35;
+            s[i] = v ^ (v >> 16);
+        }
+        x = _mm_setr_epi32(s[0], s[1], s[2], s[3]);
+        y = _mm_setr_epi32(s[4], s[5], s[6], s[7]);
+        z = _mm_setr_epi32(s[8], s[9], s[10], s[11]);
+        w = _mm_or_si128(_mm_setr_epi32(s[12], s[13], s[14], s[15]), _mm_set1_epi32(1));
+    }
+
+    // uniform in [0, 1). the top 23 bits become the mantissa of a float in [1, 2).
+    float_4 uniform() {
+        __m128i t = _mm_xor_si128(x, _mm_slli_epi32(x, 11));
+        x = y;
+        y = z;
+        z = w;
+        w = _mm_xor_si128(_mm_xor_si128(w, _mm_srli_epi32(w, 19)), _mm_xor_si128(t, _mm_srli_epi32(t, 8)));
+        __m128i bits = _mm_or_si128(_mm_srli_epi32(w, 9), _mm_set1_epi32(0x3f800000));
+        return float_4(_mm_castsi128_ps(bits)) - 1.0f;
+    }
+};
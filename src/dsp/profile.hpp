@@ -0,0 +1,104 @@
+#pragma once
+#include "simd.hpp"
+
+// optional instrumentation of the DSP code: cycle counts of code sections and counts of events like
+// discontinuities, syncs and clamps. it's compiled in by building with `make PROFILE=1`, which defines
+// KHZ_PROFILE. without it the macros below expand to nothing, so neither the counters nor the
+// arguments of the macros are compiled, and the code is the same as if it weren't instrumented.
+//
+// the macros refer to a member named profile, declared in the module under #ifdef KHZ_PROFILE.
+
+#ifdef KHZ_PROFILE
+
+#include <atomic>
+#include <initializer_list>
+#include <stdio.h>
+#include <string>
+#include <x86intrin.h>
+
+// a counter per id of a module's ProfileIds enum. sections add cycles and a call each time they run,
+// events only add to the count. the audio thread is the only writer, so the increments are plain
+// loads and stores rather than atomic read-modify-writes; the atomics only keep the UI thread from
+// reading torn values. a reset from the UI thread can lose an increment that races with it.
+template <int N>
+struct Profile {
+    const char *names[N];
+    std::atomic<uint64_t> counts[N];
+    std::atomic<uint64_t> cycles[N];
+
+    Profile(std::initializer_list<const char *> labels) {
+        int i = 0;
+        for (const char *label : labels) {
+            names[i++] = label;
+        }
+        reset();
+    }
+
+    void add(int id, uint64_t count, uint64_t elapsed = 0) {
+        counts[id].store(counts[id].load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        cycles[id].store(cycles[id].load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (int i = 0; i < N; ++i) {
+            counts[i].store(0, std::memory_order_relaxed);
+            cycles[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // one line for counter id, e.g. "sync correction: 1200 calls, 41.5 cycles/call" for a section
+    // or "syncs: 1200" for an event.
+    std::string line(int id) const {
+        uint64_t count = counts[id].load(std::memory_order_relaxed);
+        uint64_t elapsed = cycles[id].load(std::memory_order_relaxed);
+        char text[256];
+        if (elapsed == 0) {
+            snprintf(text, sizeof(text), "%s: %llu", names[id], (unsigned long long) count);
+        }
+        else {
+            snprintf(text, sizeof(text), "%s: %llu calls, %.1f cycles/call", names[id], (unsigned long long) count, (double) elapsed / count);
+        }
+        return text;
+    }
+
+    // all counters, one per line.
+    std::string dump() const {
+        std::string lines;
+        for (int i = 0; i < N; ++i) {
+            lines += line(i) + "\n";
+        }
+        return lines;
+    }
+};
+
+// adds the cycles from its construction to its destruction to a section.
+template <class TProfile>
+struct ProfileScope {
+    TProfile &profile;
+    int id;
+    uint64_t start;
+
+    ProfileScope(TProfile &profile, int id) : profile(profile), id(id), start(__rdtsc()) {}
+    ~ProfileScope() {
+        profile.add(id, 1, __rdtsc() - start);
+    }
+};
+
+// the number of lanes set in a float_4 mask, for counting per-voice events.
+inline int profileLanes(rack::simd::float_4 mask) {
+    return __builtin_popcount(rack::simd::movemask(mask));
+}
+
+#define KHZ_PROFILE_CONCAT_(a, b) a##b
+#define KHZ_PROFILE_CONCAT(a, b) KHZ_PROFILE_CONCAT_(a, b)
+// times the rest of the enclosing scope as section id.
+#define KHZ_PROFILE_SCOPE(id) ProfileScope<decltype(profile)> KHZ_PROFILE_CONCAT(profileScope, __LINE__)(profile, id)
+// adds count to event id.
+#define KHZ_PROFILE_COUNT(id, count) profile.add(id, count)
+
+#else
+
+#define KHZ_PROFILE_SCOPE(id)
+#define KHZ_PROFILE_COUNT(id, count)
+
+#endif
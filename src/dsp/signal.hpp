@@ -0,0 +1,37 @@
+#pragma once
+#include "simd.hpp"
+
+
+// a polyphonic signal the engines read from or write to, with the interface of rack's Port. it doesn't
+// own its voltages: in the plugin, the module points it at a port's voltages once and copies the
+// channel count in before each frame and out after it, so the engines work on the ports directly and
+// don't depend on Rack. other hosts point it at their own buffers of up to 16 channels.
+struct PolySignal {
+    float *voltages = nullptr;
+    // 0 while unpatched. like a port, it stays at 0 when set to some other count.
+    int channels = 0;
+
+    bool isConnected() const {
+        return channels > 0;
+    }
+    int getChannels() const {
+        return channels;
+    }
+    void setChannels(int c) {
+        if (channels > 0) {
+            channels = c;
+        }
+    }
+    float getVoltage(int c = 0) const {
+        return voltages[c];
+    }
+    // like a port, a monophonic signal is shared by all channels.
+    template <typename T>
+    T getPolyVoltageSimd(int c) const {
+        return (channels == 1) ? T(voltages[0]) : T::load(voltages + c);
+    }
+    template <typename T>
+    void setVoltageSimd(T v, int c) {
+        v.store(voltages + c);
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+// the engines use Rack's float_4 and simd functions. the plugin takes them from the SDK, and builds
+// without it (the static library in this directory, bench/ and test/) define KHZ_STANDALONE and get
+// the stand-in below, which follows the SDK's interface for the parts the engines use.
+#ifndef KHZ_STANDALONE
+
+#include "rack.hpp"
+
+#else
+
+#include <cmath>
+#include <immintrin.h>
+
+
+namespace rack {
+
+namespace simd {
+
+template <typename T, int N>
+struct Vector;
+
+template <>
+struct Vector<float, 4> {
+    union {
+        __m128 v;
+        float s[4];
+    };
+    Vector() = default;
+    Vector(__m128 v) : v(v) {}
+    Vector(float x) : v(_mm_set1_ps(x)) {}
+    Vector(float x1, float x2, float x3, float x4) : v(_mm_setr_ps(x1, x2, x3, x4)) {}
+    float &operator[](int i) { return s[i]; }
+    const float &operator[](int i) const { return s[i]; }
+    static Vector zero() { return Vector(_mm_setzero_ps()); }
+    static Vector mask() { return Vector(_mm_castsi128_ps(_mm_set1_epi32(-1))); }
+    static Vector load(const float *x) { return Vector(_mm_loadu_ps(x)); }
+    void store(float *x) { _mm_storeu_ps(x, v); }
+};
+
+typedef Vector<float, 4> float_4;
+
+#define SIMD_OP(op, fn) \
+    inline float_4 operator op(float_4 a, float_4 b) { return float_4(fn(a.v, b.v)); } \
+    inline float_4 &operator op##=(float_4 &a, float_4 b) { return a = a op b; }
+SIMD_OP(+, _mm_add_ps)
+SIMD_OP(-, _mm_sub_ps)
+SIMD_OP(*, _mm_mul_ps)
+SIMD_OP(/, _mm_div_ps)
+SIMD_OP(&, _mm_and_ps)
+SIMD_OP(|, _mm_or_ps)
+SIMD_OP(^, _mm_xor_ps)
+#undef SIMD_OP
+
+#define SIMD_CMP(op, fn) \
+    inline float_4 operator op(float_4 a, float_4 b) { return float_4(fn(a.v, b.v)); }
+SIMD_CMP(==, _mm_cmpeq_ps)
+SIMD_CMP(!=, _mm_cmpneq_ps)
+SIMD_CMP(<, _mm_cmplt_ps)
+SIMD_CMP(<=, _mm_cmple_ps)
+SIMD_CMP(>, _mm_cmpgt_ps)
+SIMD_CMP(>=, _mm_cmpge_ps)
+#undef SIMD_CMP
+
+inline float_4 operator+(float_4 a) { return a; }
+inline float_4 operator-(float_4 a) { return float_4(0.0f) - a; }
+inline float_4 operator~(float_4 a) { return a ^ float_4::mask(); }
+
+using std::fmax;
+using std::fmin;
+using std::floor;
+using std::pow;
+
+inline float ifelse(bool cond, float a, float b) { return cond ? a : b; }
+inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) { return float_4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))); }
+inline int movemask(float_4 a) { return _mm_movemask_ps(a.v); }
+inline float_4 fmin(float_4 a, float_4 b) { return float_4(_mm_min_ps(a.v, b.v)); }
+inline float_4 fmax(float_4 a, float_4 b) { return float_4(_mm_max_ps(a.v, b.v)); }
+inline float_4 clamp(float_4 x, float_4 a = 0.0f, float_4 b = 1.0f) { return fmin(fmax(x, a), b); }
+inline float_4 floor(float_4 a) { return float_4(_mm_floor_ps(a.v)); }
+inline float_4 pow(float a, float_4 b) {
+    float_4 y;
+    for (int i = 0; i < 4; ++i) {
+        y.s[i] = std::pow(a, b.s[i]);
+    }
+    return y;
+}
+
+} // namespace simd
+
+} // namespace rack
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+
+// hands the latest value of a T from one thread to another without locks, e.g. settings chosen in the
+// context menu on the UI thread to the audio thread. the writer and the reader each own one of three
+// buffers and swap it with the middle one, so neither ever touches a buffer the other is using, and
+// the reader always gets the most recent complete write. there must be only one writer and one reader.
+template <typename T>
+struct TripleBuffer {
+    // the index of the middle buffer, with FRESH set when it holds a write the reader hasn't taken.
+    static const int FRESH = 4;
+
+    T buffers[3];
+    std::atomic<int> middle;
+    int back = 0;
+    int front = 2;
+
+    TripleBuffer() : middle(1) {}
+
+    void write(const T &value) {
+        buffers[back] = value;
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    // copies the latest write to value and returns true, or returns false if nothing was written since
+    // the last read.
+    bool read(T &value) {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+        value = buffers[front];
+        return true;
+    }
+};
+
+// the knob values, copied out of the module's params in one pass per control update, so the DSP code
+// reads each Param once and otherwise works on a plain array.
+template <int N>
+struct ParamSnapshot {
+    float values[N] = {};
+
+    template <typename TParams>
+    void take(const TParams &params) {
+        for (int i = 0; i < N; ++i) {
+            values[i] = params[i].value;
+        }
+    }
+    float operator[](int i) const {
+        return values[i];
+    }
+};
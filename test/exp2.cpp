@@ -0,0 +1,43 @@
+// checks each accuracy tier of exp2Approx against double precision over the whole pitch range, for
+// both the scalar and the simd version, and fails if a tier is past the bound documented with
+// Exp2Accuracy in src/dsp/math.hpp.
+#include <stdio.h>
+#include <algorithm>
+#include "dsp/math.hpp"
+
+
+// pitches in log2 Hz, from below 1 Hz to above the highest sample rates, with a step that doesn't
+// divide an octave so the fractional parts cover the whole interval.
+static const double LOWEST = -4.0;
+static const double HIGHEST = 18.0;
+static const double STEP = 1.0 / 65536.0 + 1e-9;
+
+
+static double cents(double approx, double x) {
+    return 1200.0 * std::fabs(std::log2(approx) - x);
+}
+
+
+int main() {
+    static const char *names[] = {"exact", "high", "medium", "low"};
+    static const double bounds[] = {0.002, 0.002, 0.2, 5.0};
+    int failures = 0;
+    for (int accuracy = EXP2_EXACT; accuracy < NUM_EXP2_ACCURACIES; ++accuracy) {
+        double worst = 0.0;
+        double worstSimd = 0.0;
+        for (double x = LOWEST; x < HIGHEST; x += 4.0 * STEP) {
+            float_4 xs(x, x + STEP, x + 2.0 * STEP, x + 3.0 * STEP);
+            float_4 ys = exp2Approx(xs, accuracy);
+            for (int lane = 0; lane < 4; ++lane) {
+                // the error is measured from the float the approximation actually got.
+                worst = std::max(worst, cents(exp2Approx(xs[lane], accuracy), xs[lane]));
+                worstSimd = std::max(worstSimd, cents(ys[lane], xs[lane]));
+            }
+        }
+        bool pass = worst <= bounds[accuracy] && worstSimd <= bounds[accuracy];
+        printf("exp2Approx %-8s %s: max error %.5f cents, simd %.5f cents, bound %g\n", names[accuracy], pass ? "ok" : "FAIL",
+               worst, worstSimd, bounds[accuracy]);
+        failures += !pass;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,439 @@
+// renders each module for scripted CV sequences and compares the outputs against stored golden files,
+// so optimizations can be checked against the reference output. the random generators are seeded,
+// so every render is reproducible. run with --update to rewrite the golden files after an intended
+// change in the output.
+#include <fstream>
+#include "../src/dsp/PalmLoopEngine.cpp"
+#include "../src/PalmLoop.cpp"
+#include "../src/dsp/TachyonEntanglerEngine.cpp"
+#include "../src/TachyonEntangler.cpp"
+#include "../src/dsp/D_InfEngine.cpp"
+#include "../src/D_Inf.cpp"
+
+
+Plugin *pluginInstance;
+
+
+static const float SAMPLE_RATE = 48000.0f;
+static const int FRAMES = 2048;
+// the largest difference in volts that still counts as the same output. approximations below this,
+// e.g. a different exp2 tier or reordered float math, pass, while changes in the waveforms fail.
+static const float TOLERANCE = 2e-3f;
+
+
+// renders FRAMES frames of module with script setting its inputs and params before each frame, and
+// returns the outputs frame by frame, channel by channel.
+template <class TModule>
+std::vector<float> render(TModule &module, int channels, std::function<void(TModule &, int)> script) {
+    for (Output &output : module.outputs) {
+        output.channels = 1;
+    }
+    Module::ProcessArgs args = {SAMPLE_RATE, 1.0f / SAMPLE_RATE};
+    APP->engine->sampleTime = args.sampleTime;
+    module.onSampleRateChange();
+
+    std::vector<float> rendered;
+    for (int i = 0; i < FRAMES; ++i) {
+        script(module, i);
+        module.process(args);
+        for (Output &output : module.outputs) {
+            for (int c = 0; c < channels; ++c) {
+                rendered.push_back(output.getVoltage(c));
+            }
+        }
+    }
+    return rendered;
+}
+
+
+static void setPoly(Port &port, int channels, std::function<float(int)> voltage) {
+    port.channels = channels;
+    for (int c = 0; c < channels; ++c) {
+        port.setVoltage(voltage(c), c);
+    }
+}
+
+
+static float sine(float freq, int i) {
+    return 5.0f * std::sin(2.0f * M_PI * freq * i / SAMPLE_RATE);
+}
+
+
+// a trigger every period frames, rising from 0 V so that it crosses 1 V at a different point between
+// two samples each time, from 0.4 to 1 of the way.
+static float resetRamp(float period, int i) {
+    float n = std::floor(i / period);
+    float t = i - n * period;
+    if (t < 1.0f) {
+        float crossing = 0.4f + 0.6f * (n * 0.618034f - std::floor(n * 0.618034f));
+        return 1.0f / crossing;
+    }
+    return (t < 5.0f) ? 10.0f : 0.0f;
+}
+
+
+struct Case {
+    std::string name;
+    std::function<std::vector<float>()> render;
+};
+
+
+static std::vector<Case> cases() {
+    std::vector<Case> cases;
+
+    for (int quality = 0; quality < PalmLoop::NUM_BLEP_QUALITIES; ++quality) {
+        cases.push_back({string::f("PalmLoop_pitch_sequence_blep%d", 2 << quality), [=]() {
+            PalmLoop module;
+            module.settings.blepQuality = quality;
+            module.publishSettings();
+            return render<PalmLoop>(module, 1, [](PalmLoop &m, int i) {
+                static const float notes[] = {0.0f, 0.58333f, 1.25f, -1.0f, 2.41667f, 3.0f, -0.25f, 1.91667f};
+                setPoly(m.inputs[PalmLoop::V_OCT_INPUT], 1, [=](int c) { return notes[(i / 512) % 8]; });
+            });
+        }});
+    }
+    cases.push_back({"PalmLoop_lin_fm_reset_4_voices", []() {
+        PalmLoop module;
+        module.params[PalmLoop::LIN_FM_PARAM].setValue(4.0f);
+        return render<PalmLoop>(module, 4, [](PalmLoop &m, int i) {
+            setPoly(m.inputs[PalmLoop::V_OCT_INPUT], 4, [](int c) { return 0.25f * c; });
+            setPoly(m.inputs[PalmLoop::LIN_FM_INPUT], 4, [=](int c) { return sine(220.0f * (c + 1), i); });
+            setPoly(m.inputs[PalmLoop::RESET_INPUT], 1, [=](int c) { return (i % 1000 < 10) ? 10.0f : 0.0f; });
+        });
+    }});
+    // at about 8 kHz the phase moves a sixth of a cycle per sample, so some of the resets land just
+    // after a wrap in the same frame.
+    cases.push_back({"PalmLoop_reset_after_wrap_high_pitch", []() {
+        PalmLoop module;
+        return render<PalmLoop>(module, 4, [](PalmLoop &m, int i) {
+            setPoly(m.inputs[PalmLoop::V_OCT_INPUT], 4, [=](int c) { return 4.7f + 0.1f * c + 0.5f * i / FRAMES; });
+            setPoly(m.inputs[PalmLoop::RESET_INPUT], 4, [=](int c) { return resetRamp(37.3f + 2.1f * c, i); });
+        });
+    }});
+    // the outputs are unpatched for a while and then the same ones are patched again, so the engine
+    // sleeps and wakes up with the same outputs.
+    cases.push_back({"PalmLoop_sleep_and_wake", []() {
+        PalmLoop module;
+        return render<PalmLoop>(module, 1, [](PalmLoop &m, int i) {
+            setPoly(m.inputs[PalmLoop::V_OCT_INPUT], 1, [](int c) { return 2.3f; });
+            for (Output &output : m.outputs) {
+                output.channels = (i >= 700 && i < 1300) ? 0 : 1;
+            }
+        });
+    }});
+    // low latency is switched on, and off again after the outputs slept in between, so the engine goes
+    // through both changes of the block length and wakes up rendering single frames.
+    cases.push_back({"PalmLoop_low_latency_switch", []() {
+        PalmLoop module;
+        module.params[PalmLoop::LIN_FM_PARAM].setValue(2.0f);
+        return render<PalmLoop>(module, 1, [](PalmLoop &m, int i) {
+            if (i == 500 || i == 1500) {
+                m.settings.lowLatency = (i == 500);
+                m.publishSettings();
+            }
+            setPoly(m.inputs[PalmLoop::V_OCT_INPUT], 1, [=](int c) { return 0.5f + 0.5f * i / FRAMES; });
+            setPoly(m.inputs[PalmLoop::LIN_FM_INPUT], 1, [=](int c) { return sine(330.0f, i); });
+            setPoly(m.inputs[PalmLoop::RESET_INPUT], 1, [=](int c) { return resetRamp(211.7f, i); });
+            for (Output &output : m.outputs) {
+                output.channels = (i >= 900 && i < 1100) ? 0 : 1;
+            }
+        });
+    }});
+    cases.push_back({"PalmLoop_exp_fm", []() {
+        PalmLoop module;
+        module.params[PalmLoop::EXP_FM_PARAM].setValue(0.4f);
+        module.params[PalmLoop::FINE_PARAM].setValue(0.03f);
+        return render<PalmLoop>(module, 1, [](PalmLoop &m, int i) {
+            setPoly(m.inputs[PalmLoop::EXP_FM_INPUT], 1, [=](int c) { return sine(97.0f, i); });
+        });
+    }});
+
+    for (int mode = PalmLoop::SINE_TABLE_LINEAR; mode < PalmLoop::NUM_SINE_MODES; ++mode) {
+        cases.push_back({string::f("PalmLoop_sine_table_%s", (mode == PalmLoop::SINE_TABLE_LINEAR) ? "linear" : "cubic"), [=]() {
+            PalmLoop module;
+            module.settings.sineMode = mode;
+            module.publishSettings();
+            module.params[PalmLoop::EXP_FM_PARAM].setValue(0.4f);
+            return render<PalmLoop>(module, 1, [](PalmLoop &m, int i) {
+                setPoly(m.inputs[PalmLoop::EXP_FM_INPUT], 1, [=](int c) { return sine(97.0f, i); });
+            });
+        }});
+    }
+
+    cases.push_back({"PalmLoop_unison_7_voices_stereo", []() {
+        PalmLoop module;
+        module.settings.unisonVoices = 7;
+        module.settings.unisonSpread = 20;
+        module.settings.unisonWidth = 100;
+        module.publishSettings();
+        return render<PalmLoop>(module, 2, [](PalmLoop &m, int i) {
+            setPoly(m.inputs[PalmLoop::V_OCT_INPUT], 1, [=](int c) { return (i < 1024) ? 0.0f : -1.0f; });
+            setPoly(m.inputs[PalmLoop::RESET_INPUT], 1, [=](int c) { return (i % 1500 < 10) ? 10.0f : 0.0f; });
+        });
+    }});
+
+    cases.push_back({"TachyonEntangler_sync_sweep", []() {
+        TachyonEntangler module;
+        module.seed(1);
+        return render<TachyonEntangler>(module, 1, [](TachyonEntangler &m, int i) {
+            m.params[TachyonEntangler::B_RATIO_PARAM].setValue(4.0f * i / FRAMES);
+        });
+    }});
+    cases.push_back({"TachyonEntangler_chaos_half_sync_2_voices", []() {
+        TachyonEntangler module;
+        module.seed(2);
+        module.params[TachyonEntangler::A_CHAOS_PARAM].setValue(0.7f);
+        module.params[TachyonEntangler::B_CHAOS_PARAM].setValue(0.3f);
+        module.params[TachyonEntangler::A_SYNC_PROB_PARAM].setValue(0.5f);
+        module.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(0.5f);
+        module.params[TachyonEntangler::B_RATIO_PARAM].setValue(0.7f);
+        return render<TachyonEntangler>(module, 2, [](TachyonEntangler &m, int i) {
+            setPoly(m.inputs[TachyonEntangler::A_V_OCT_INPUT], 2, [](int c) { return -0.5f * c; });
+        });
+    }});
+    cases.push_back({"TachyonEntangler_fm_reset_oversampled", []() {
+        TachyonEntangler module;
+        module.seed(3);
+        module.settings.oversampling = 2;
+        module.publishSettings();
+        module.params[TachyonEntangler::A_LIN_FM_PARAM].setValue(3.0f);
+        module.params[TachyonEntangler::B_EXP_FM_PARAM].setValue(1.0f);
+        module.params[TachyonEntangler::B_RATIO_PARAM].setValue(1.5f);
+        return render<TachyonEntangler>(module, 1, [](TachyonEntangler &m, int i) {
+            setPoly(m.inputs[TachyonEntangler::A_LIN_FM_INPUT], 1, [=](int c) { return sine(330.0f, i); });
+            setPoly(m.inputs[TachyonEntangler::B_EXP_FM_INPUT], 1, [=](int c) { return sine(55.0f, i); });
+            setPoly(m.inputs[TachyonEntangler::B_RESET_INPUT], 1, [=](int c) { return (i % 700 < 5) ? 10.0f : 0.0f; });
+        });
+    }});
+    cases.push_back({"TachyonEntangler_reset_after_wrap_high_pitch", []() {
+        TachyonEntangler module;
+        module.seed(5);
+        module.params[TachyonEntangler::A_SYNC_PROB_PARAM].setValue(0.0f);
+        module.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(0.0f);
+        module.params[TachyonEntangler::B_RATIO_PARAM].setValue(0.3f);
+        return render<TachyonEntangler>(module, 1, [](TachyonEntangler &m, int i) {
+            setPoly(m.inputs[TachyonEntangler::A_V_OCT_INPUT], 1, [=](int c) { return 4.7f + 0.5f * i / FRAMES; });
+            setPoly(m.inputs[TachyonEntangler::A_RESET_INPUT], 1, [=](int c) { return resetRamp(37.3f, i); });
+        });
+    }});
+    // the inputs go from 1 to 16 channels between two control updates, so the new voices have to
+    // start with the chaos and sync probabilities of the knobs rather than wait for the next update.
+    cases.push_back({"TachyonEntangler_channels_1_to_16", []() {
+        TachyonEntangler module;
+        module.seed(6);
+        module.settings.controlInterval = 64;
+        module.publishSettings();
+        module.params[TachyonEntangler::A_CHAOS_PARAM].setValue(0.6f);
+        module.params[TachyonEntangler::B_CHAOS_PARAM].setValue(0.4f);
+        module.params[TachyonEntangler::A_SYNC_PROB_PARAM].setValue(0.7f);
+        module.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(0.5f);
+        module.params[TachyonEntangler::B_CHAOS_MOD_PARAM].setValue(0.1f);
+        module.params[TachyonEntangler::B_RATIO_PARAM].setValue(0.9f);
+        return render<TachyonEntangler>(module, 16, [](TachyonEntangler &m, int i) {
+            int channels = (i < 1000) ? 1 : 16;
+            setPoly(m.inputs[TachyonEntangler::A_V_OCT_INPUT], channels, [](int c) { return 0.1f * c; });
+            setPoly(m.inputs[TachyonEntangler::B_CHAOS_INPUT], channels, [](int c) { return 0.5f * (c % 5); });
+        });
+    }});
+    // oscillator B's saw is patched back into A's lin fm input, the feedback patch low latency is for.
+    cases.push_back({"TachyonEntangler_low_latency_cross_mod", []() {
+        TachyonEntangler module;
+        module.seed(7);
+        module.settings.lowLatency = 1;
+        module.publishSettings();
+        module.params[TachyonEntangler::A_LIN_FM_PARAM].setValue(2.0f);
+        module.params[TachyonEntangler::A_CHAOS_PARAM].setValue(0.2f);
+        module.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(0.4f);
+        module.params[TachyonEntangler::B_RATIO_PARAM].setValue(0.8f);
+        return render<TachyonEntangler>(module, 1, [](TachyonEntangler &m, int i) {
+            float feedback = m.outputs[TachyonEntangler::B_SAW_OUTPUT].getVoltage();
+            setPoly(m.inputs[TachyonEntangler::A_LIN_FM_INPUT], 1, [=](int c) { return feedback; });
+            setPoly(m.inputs[TachyonEntangler::A_RESET_INPUT], 1, [=](int c) { return resetRamp(173.1f, i); });
+        });
+    }});
+    cases.push_back({"TachyonEntangler_ring_of_4_chaos", []() {
+        TachyonEntangler module;
+        module.seed(4);
+        module.settings.oscillators = 4;
+        module.publishSettings();
+        module.params[TachyonEntangler::A_CHAOS_PARAM].setValue(0.2f);
+        module.params[TachyonEntangler::B_CHAOS_PARAM].setValue(0.6f);
+        module.params[TachyonEntangler::A_SYNC_PROB_PARAM].setValue(0.3f);
+        module.params[TachyonEntangler::B_SYNC_PROB_PARAM].setValue(0.9f);
+        module.params[TachyonEntangler::B_RATIO_PARAM].setValue(1.2f);
+        return render<TachyonEntangler>(module, 1, [](TachyonEntangler &m, int i) {
+            setPoly(m.inputs[TachyonEntangler::A_LIN_FM_INPUT], 1, [=](int c) { return sine(110.0f, i); });
+        });
+    }});
+
+    cases.push_back({"D_Inf_triggers", []() {
+        D_Inf module;
+        module.params[D_Inf::OCTAVE_PARAM].setValue(1.0f);
+        module.params[D_Inf::COARSE_PARAM].setValue(-3.0f);
+        module.params[D_Inf::HALF_SHARP_PARAM].setValue(1.0f);
+        module.params[D_Inf::INVERT_PARAM].setValue(1.0f);
+        return render<D_Inf>(module, 1, [](D_Inf &m, int i) {
+            setPoly(m.inputs[D_Inf::A_INPUT], 1, [=](int c) { return sine(3.0f, i); });
+            setPoly(m.inputs[D_Inf::INVERT_INPUT], 1, [=](int c) { return (i % 300 < 150) ? 10.0f : 0.0f; });
+            setPoly(m.inputs[D_Inf::TRANSPOSE_INPUT], 1, [=](int c) { return (i % 700 < 350) ? 10.0f : 0.0f; });
+        });
+    }});
+
+    cases.push_back({"D_Inf_poly_triggers_5_channels", []() {
+        D_Inf module;
+        module.params[D_Inf::COARSE_PARAM].setValue(5.0f);
+        module.params[D_Inf::INVERT_PARAM].setValue(1.0f);
+        return render<D_Inf>(module, 5, [](D_Inf &m, int i) {
+            setPoly(m.inputs[D_Inf::A_INPUT], 5, [=](int c) { return sine(2.0f + c, i); });
+            setPoly(m.inputs[D_Inf::INVERT_INPUT], 5, [=](int c) { return (i % (200 + 50 * c) < 100) ? 10.0f : 0.0f; });
+            setPoly(m.inputs[D_Inf::TRANSPOSE_INPUT], 1, [=](int c) { return (i % 700 < 350) ? 10.0f : 0.0f; });
+        });
+    }});
+    cases.push_back({"D_Inf_chain_of_3", []() {
+        // three D_Infs side by side stacking a fifth, an octave and a major third on a 3-note chord. the
+        // middle one's output is unpatched, and the last one's input takes it through the chain.
+        static const float octaves[] = {0.0f, 1.0f, 0.0f};
+        static const float coarse[] = {7.0f, 0.0f, 4.0f};
+        D_Inf modules[3];
+        for (int m = 0; m < 3; ++m) {
+            modules[m].model = modelD_Inf;
+            modules[m].params[D_Inf::OCTAVE_PARAM].setValue(octaves[m]);
+            modules[m].params[D_Inf::COARSE_PARAM].setValue(coarse[m]);
+            if (m > 0) {
+                modules[m].chained = 1;
+                modules[m].leftExpander.module = &modules[m - 1];
+                modules[m - 1].rightExpander.module = &modules[m];
+            }
+        }
+        modules[0].outputs[D_Inf::A_OUTPUT].channels = 1;
+        modules[2].outputs[D_Inf::A_OUTPUT].channels = 1;
+
+        Module::ProcessArgs args = {SAMPLE_RATE, 1.0f / SAMPLE_RATE};
+        std::vector<float> rendered;
+        for (int i = 0; i < FRAMES; ++i) {
+            setPoly(modules[0].inputs[D_Inf::A_INPUT], 3, [=](int c) { return 0.1f * sine(1.0f + c, i); });
+            setPoly(modules[1].inputs[D_Inf::TRANSPOSE_INPUT], 1, [=](int c) { return (i % 600 < 300) ? 10.0f : 0.0f; });
+            for (D_Inf &module : modules) {
+                module.process(args);
+            }
+            for (int m : {0, 2}) {
+                for (int c = 0; c < 3; ++c) {
+                    rendered.push_back(modules[m].outputs[D_Inf::A_OUTPUT].getVoltage(c));
+                }
+            }
+        }
+        return rendered;
+    }});
+    cases.push_back({"D_Inf_chain_first_disabled", []() {
+        // the same chain, with the first module disabled for the first half. rack doesn't process it
+        // then, so the other two form a chain of their own, started by the middle one, whose A input
+        // is unpatched.
+        static const float octaves[] = {0.0f, 1.0f, 0.0f};
+        static const float coarse[] = {7.0f, 0.0f, 4.0f};
+        D_Inf modules[3];
+        for (int m = 0; m < 3; ++m) {
+            modules[m].model = modelD_Inf;
+            modules[m].params[D_Inf::OCTAVE_PARAM].setValue(octaves[m]);
+            modules[m].params[D_Inf::COARSE_PARAM].setValue(coarse[m]);
+            if (m > 0) {
+                modules[m].chained = 1;
+                modules[m].leftExpander.module = &modules[m - 1];
+                modules[m - 1].rightExpander.module = &modules[m];
+            }
+        }
+        modules[0].outputs[D_Inf::A_OUTPUT].channels = 1;
+        modules[2].outputs[D_Inf::A_OUTPUT].channels = 1;
+
+        Module::ProcessArgs args = {SAMPLE_RATE, 1.0f / SAMPLE_RATE};
+        std::vector<float> rendered;
+        for (int i = 0; i < FRAMES; ++i) {
+            modules[0].bypass = i < FRAMES / 2;
+            setPoly(modules[0].inputs[D_Inf::A_INPUT], 3, [=](int c) { return 0.1f * sine(1.0f + c, i); });
+            for (D_Inf &module : modules) {
+                if (!module.bypass) {
+                    module.process(args);
+                }
+            }
+            for (int c = 0; c < 3; ++c) {
+                rendered.push_back(modules[2].outputs[D_Inf::A_OUTPUT].getVoltage(c));
+            }
+        }
+        return rendered;
+    }});
+
+    return cases;
+}
+
+
+static std::string goldenPath(const std::string &name) {
+    return "golden/" + name + ".f32";
+}
+
+
+static bool readGolden(const std::string &name, std::vector<float> &golden) {
+    std::ifstream file(goldenPath(name), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    golden.resize(file.tellg() / sizeof(float));
+    file.seekg(0);
+    file.read((char *) golden.data(), golden.size() * sizeof(float));
+    return bool(file);
+}
+
+
+static void writeGolden(const std::string &name, const std::vector<float> &rendered) {
+    std::ofstream file(goldenPath(name), std::ios::binary);
+    file.write((const char *) rendered.data(), rendered.size() * sizeof(float));
+}
+
+
+// usage: regression [--update]
+// each case is checked with the kernels of every CpuLevel this machine supports, against the same golden
+// file. the golden files are written with the baseline kernels.
+int main(int argc, char **argv) {
+    bool update = (argc > 1) && std::string(argv[1]) == "--update";
+    int maxLevel = update ? CPU_SSE4 : detectCpuLevel();
+    int failures = 0;
+    for (const Case &c : cases()) {
+        for (int level = CPU_SSE4; level <= maxLevel; ++level) {
+            cpuLevel() = level;
+            std::string label = c.name + " (" + cpuLevelName(level) + ")";
+            std::vector<float> rendered = c.render();
+            if (update) {
+                writeGolden(c.name, rendered);
+                printf("%-56s updated\n", label.c_str());
+                continue;
+            }
+            std::vector<float> golden;
+            if (!readGolden(c.name, golden)) {
+                printf("%-56s FAIL: no golden file at %s\n", label.c_str(), goldenPath(c.name).c_str());
+                ++failures;
+                continue;
+            }
+            if (golden.size() != rendered.size()) {
+                printf("%-56s FAIL: %zu samples, golden has %zu\n", label.c_str(), rendered.size(), golden.size());
+                ++failures;
+                continue;
+            }
+            float maxError = 0.0f;
+            size_t worst = 0;
+            for (size_t i = 0; i < golden.size(); ++i) {
+                float error = std::fabs(rendered[i] - golden[i]);
+                // a NaN never compares greater, so it's caught separately.
+                if (error > maxError || error != error) {
+                    maxError = error;
+                    worst = i;
+                }
+            }
+            bool pass = maxError <= TOLERANCE;
+            printf("%-56s %s: max error %g V at sample %zu\n", label.c_str(), pass ? "ok" : "FAIL", maxError, worst);
+            failures += !pass;
+        }
+    }
+    if (failures) {
+        printf("%d case%s failed\n", failures, failures > 1 ? "s" : "");
+    }
+    return failures ? 1 : 0;
+}